@@ -60,6 +60,13 @@ void tick_default(void) {
 
     static char night=0;
     static char posleds = 0;
+
+    // a few samples are enough, each one makes getRandom() rekey
+    EVERY(64,1){
+        if(!adcMutex)
+            randomAddEntropy(adcRead(1));
+    };
+
     EVERY(128,2){
         if( isNight() ){
             if( GLOBAL(positionleds) ){
@@ -82,10 +89,10 @@ void tick_default(void) {
             night=isNight();
             if(night){
                 backlightSetBrightness(GLOBAL(lcdbacklight));
-                push_queue(queue_unsetinvert);
+                push_queue_prio(queue_unsetinvert, QP_UI);
             }else{
                 backlightSetBrightness(0);
-                push_queue(queue_setinvert);
+                push_queue_prio(queue_setinvert, QP_UI);
            };
         };
     };
@@ -122,7 +129,7 @@ void tick_default(void) {
     };
 
     EVERY(4096,17){
-        push_queue(nrf_check_reset);
+        push_queue_prio(nrf_check_reset, QP_RADIO);
     };
     return;
 };
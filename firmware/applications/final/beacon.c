@@ -28,7 +28,7 @@ void tick_beacon(void){
         return;
 
     if(beaconctr--<0){
-        push_queue(&do_openbeacon);
+        push_queue_prio(&do_openbeacon, QP_RADIO);
         beaconctr=B_INTERVAL/SYSTICKSPEED/2;
         beaconctr+=getRandom()%(beaconctr*2);
     };
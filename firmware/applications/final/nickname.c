@@ -38,7 +38,7 @@ void simpleNickname(void) {
 	ctr++;
 
 	setExtFont(GLOBAL(nickfont));
-	dx=DoString(0,0,GLOBAL(nickname));
+	dx=getStringWidth(GLOBAL(nickname));
     dx=(RESX-dx)/2;
     if(dx<0)
         dx=0;
@@ -23,7 +23,7 @@ void s_ticks(void) {
     dx=DoString(0,dy+16,"Qdepth:");
     while ((getInputRaw())==BTN_NONE){
         DoInt(0,dy+8,_timectr);
-        DoInt(dx,dy+16,(the_queue.qend-the_queue.qstart+MAXQENTRIES)%MAXQENTRIES);
+        DoInt(dx,dy+16,the_queue.depth);
         lcdDisplay();
         __asm volatile ("WFI");
     };
@@ -48,3 +48,92 @@ void push_q(void) {
     push_queue(&b_one);
 };
 
+
+static char q_trace[16];
+static uint8_t q_pos;
+static uint8_t q_ticks;
+
+static void q_ui(void)    { q_trace[q_pos++]='u'; };
+static void q_radio(void) { q_trace[q_pos++]='r'; };
+static void q_store(void) { q_trace[q_pos++]='s'; };
+static void q_bg(void)    { q_trace[q_pos++]='b'; };
+static void q_tick(void)  { q_ticks++; };
+
+static uint8_t q_plus(uint8_t state){
+    q_trace[q_pos++]='0'+state;
+    if(state==0)
+        push_queue_prio(&q_ui, QP_UI);
+    if(state==2)
+        return QS_END;
+    return state+1;
+};
+
+static void q_check(const char *name, const char *expect){
+    while(the_queue.depth)
+        work_queue_minimal();
+    q_trace[q_pos]=0;
+    lcdPrint(name);
+    if(strcmp(q_trace, expect)){
+        lcdPrint(" !");
+        lcdPrintln(q_trace);
+    }else
+        lcdPrintln(" ok");
+    q_pos=0;
+};
+
+void s_prio(void) {
+    QTIMER once={.prio=QP_RADIO, .u.callback=&q_radio};
+    QTIMER every={.prio=QP_BACKGROUND, .period=2, .u.callback=&q_tick};
+    uint32_t start;
+    int i;
+
+    lcdClear();
+    while(the_queue.depth)
+        work_queue_minimal();
+
+    push_queue_prio(&q_bg, QP_BACKGROUND);
+    push_queue_prio(&q_store, QP_STORAGE);
+    push_queue_prio(&q_radio, QP_RADIO);
+    push_queue_prio(&q_ui, QP_UI);
+    push_queue_prio(&q_store, QP_STORAGE);
+    q_check("order", "urssb");
+
+    push_queue_plus_prio(&q_plus, QP_BACKGROUND);
+    push_queue_prio(&q_store, QP_STORAGE);
+    q_check("plus", "s0u12");
+
+    for(i=0;i<MAXQENTRIES;i++)
+        push_queue_prio(&q_bg, QP_BACKGROUND);
+    i=the_queue.dropped;
+    lcdPrint("full");
+    lcdPrintln(push_queue_prio(&q_ui, QP_UI)==-1
+            && the_queue.dropped==i+1 ? " ok" : " !");
+    q_pos=0;
+    while(the_queue.depth)
+        work_queue_minimal();
+    q_pos=0;
+
+    start=getTimer();
+    timerStart(&once, 30);
+    while(once.armed && getTimer()-start<100)
+        work_queue();
+    while(the_queue.depth)
+        work_queue_minimal();
+    q_trace[q_pos]=0;
+    timerStop(&once);
+    lcdPrint("once");
+    lcdPrintln(!strcmp(q_trace, "r") && getTimer()-start>=3 ? " ok" : " !");
+    q_pos=0;
+
+    q_ticks=0;
+    start=getTimer();
+    timerStart(&every, 0);
+    while(q_ticks<5 && getTimer()-start<100)
+        work_queue();
+    timerStop(&every);
+    lcdPrint("every");
+    lcdPrintln(q_ticks==5 && getTimer()-start>=9 ? " ok" : " !");
+    lcdRefresh();
+    getInputWait();
+    getInputWaitRelease();
+};
@@ -34,6 +34,7 @@ void rbInit() {
         gpioSetPullup(regs[i/2], gpioPullupMode_PullUp);
         i+=2;
     }
+    keyInit();
 
     // prepate chrg_stat
     gpioSetDir(RB_PWR_CHRG, gpioDirection_Input);
@@ -103,6 +104,8 @@ void PIOINT3_IRQHandler(void) {
         gpioIntClear(RB_BUSINT);
         businterrupt();
     }
+    if (gpioIntStatus(RB_BTN3))
+        key_irqhandler();
 }
 
 void notimplemented(void)
@@ -157,6 +157,22 @@ uint8_t getInputWaitRepeat(void);
 uint8_t getInputWaitTimeout(int timeout);
 void getInputWaitRelease(void);
 
+/* Button changes are captured by pin interrupts into an event ring */
+#define KEY_PRESS   1
+#define KEY_RELEASE 2
+#define KEY_REPEAT  3
+typedef struct {
+    uint32_t time;          /* _timectr ticks */
+    uint8_t key;            /* BTN_* bits */
+    uint8_t type;
+} KEYEVENT;
+void keyInit(void);
+uint8_t keyGetEvent(KEYEVENT *ev);
+uint8_t keyState(void);
+void key_sync(void);
+void key_irqhandler(void);
+uint32_t key_deadline(uint32_t max);
+
 // stringin.c
 void input(char prompt[], char line[], uint8_t asciistart, uint8_t asciiend, uint8_t maxlength);
 //uuid.c
@@ -191,6 +207,7 @@ void handleMenu(const struct MENU *the_menu);
 // idle.c
 
 #include "basic/idle.h"
+#include "basic/coro.h"
 
 // itoa.c
 #define F_ZEROS  (1<<0)
@@ -204,6 +221,16 @@ const char* IntToStr(int num, unsigned int mxlen, char flag);
 
 #include "basic/simpletime.h"
 
+// stack.c
+void stackPaint(void);
+uint32_t stackSize(void);
+uint32_t stackUsed(void);
+uint32_t ramStatic(void);
+
+// trace.c
+
+#include "basic/trace.h"
+
 // global
 #define SYSTICKSPEED 10
 
@@ -0,0 +1,164 @@
+#include <sysinit.h>
+
+#include "basic/basic.h"
+
+/* Started coroutines sit in co_list. coro_poll() runs whenever the work
+ * queue is polled: it checks the event sources once per tick, marks the
+ * coroutines whose event fired as ready (wait==0) and queues
+ * coro_dispatch() at the priority of the most urgent one. Waiting
+ * coroutines are never called. */
+
+#define CO_SOURCES 8
+
+static uint8_t co_button(void){
+    return getInputRaw()!=BTN_NONE;
+};
+
+static CORO *co_list;
+static CORO *co_running;
+static volatile uint8_t co_pending;
+static uint8_t co_kick;
+static uint8_t co_qprio=QPRIOS;     /* priority coro_dispatch is queued at */
+static uint32_t co_last;
+
+/* indexed by event bit */
+static uint8_t (*co_source[CO_SOURCES])(void)={NULL, NULL, &co_button};
+
+static void coro_dispatch(void){
+    CORO *c, *run=NULL;
+
+    co_qprio=QPRIOS;
+    for(c=co_list;c;c=c->next)
+        if(!c->wait && c!=co_running && (!run || c->prio<run->prio))
+            run=c;
+    if(!run)
+        return;
+
+    co_running=run;
+    if(run->fn(run)==CO_DONE)
+        coroStop(run);
+    else if(!run->wait)
+        run->wait=EV_READY;
+    co_running=NULL;
+    co_kick=1;
+};
+
+void coro_poll(void){
+    CORO *c;
+    uint32_t now=getTimer();
+    uint8_t want=0, ev=0, best=QPRIOS, i;
+
+    if(!co_list || (now==co_last && !co_pending && !co_kick))
+        return;
+    co_kick=0;
+
+    if(now!=co_last){
+        co_last=now;
+        for(c=co_list;c;c=c->next)
+            want|=c->wait;
+        for(i=0;i<CO_SOURCES;i++)
+            if(want & 1<<i && co_source[i] && co_source[i]())
+                ev|=1<<i;
+    };
+    __disable_irq();
+    ev|=co_pending;
+    co_pending=0;
+    __enable_irq();
+
+    for(c=co_list;c;c=c->next){
+        uint8_t fired=c->wait & (ev|EV_READY);
+        if(c->wait & EV_TIME && (int32_t)(now-c->until)>=0)
+            fired|=EV_TIME;
+        if(fired){
+            c->fired=fired;
+            c->wait=0;
+        };
+        if(!c->wait && c!=co_running && c->prio<best)
+            best=c->prio;
+    };
+
+    if(best<co_qprio && !push_queue_prio(&coro_dispatch, best))
+        co_qprio=best;
+};
+
+/* Ticks until a coroutine needs to run, at most max. Polled sources
+ * rule out sleeping, events raised by interrupts do not. */
+uint32_t coro_deadline(uint32_t max){
+    CORO *c;
+    uint32_t now=getTimer();
+    uint8_t i;
+
+    if(co_pending || co_kick)
+        return 0;
+    for(c=co_list;c;c=c->next){
+        if(c==co_running)
+            continue;
+        if(!c->wait || c->wait & EV_READY)
+            return 0;
+        for(i=0;i<CO_SOURCES;i++)
+            if(c->wait & 1<<i && co_source[i])
+                return 0;
+        if(c->wait & EV_TIME){
+            if((int32_t)(c->until-now)<=0)
+                return 0;
+            if(c->until-now<max)
+                max=c->until-now;
+        };
+    };
+    return max;
+};
+
+void coro_wait(CORO *c, uint8_t ev, uint32_t ms){
+    c->wait=ev;
+    c->fired=0;
+    if(ms){
+        c->wait|=EV_TIME;
+        c->until=getTimer()+(ms+SYSTICKSPEED-1)/SYSTICKSPEED;
+    };
+};
+
+/* Start c running fn from the beginning, unless it is running already */
+void coroStart(CORO *c, uint8_t (*fn)(CORO *), uint8_t prio){
+    CORO *p;
+
+    for(p=co_list;p;p=p->next)
+        if(p==c)
+            return;
+    c->fn=fn;
+    c->lc=0;
+    c->prio=prio;
+    c->wait=EV_READY;
+    c->fired=0;
+    c->next=co_list;
+    co_list=c;
+    co_kick=1;
+};
+
+void coroStop(CORO *c){
+    CORO **p;
+
+    for(p=&co_list;*p;p=&(*p)->next)
+        if(*p==c){
+            *p=c->next;
+            break;
+        };
+};
+
+/* Wake the coroutines waiting for ev, may be called from interrupts */
+void coroSignal(uint8_t ev){
+    uint32_t mask=__get_PRIMASK();
+
+    __disable_irq();
+    co_pending|=ev;
+    __set_PRIMASK(mask);
+};
+
+/* Have ev fire whenever check() returns true, polled once per tick
+ * while a coroutine waits for it */
+void coroSource(uint8_t ev, uint8_t (*check)(void)){
+    uint8_t i;
+
+    for(i=0;i<CO_SOURCES;i++)
+        if(ev & 1<<i)
+            co_source[i]=check;
+};
@@ -0,0 +1,62 @@
+#ifndef __BASICCORO_H_
+#define __BASICCORO_H_
+
+/* Stackless coroutines on top of the work queue.
+ *
+ * A coroutine is a function uint8_t fn(CORO *c) whose body is wrapped in
+ * CO_BEGIN(c)/CO_END(c). Locals do not survive a CO_AWAIT, keep state in
+ * a context struct that starts with the CORO:
+ *
+ *   static struct { CORO co; int n; } ctx;
+ *   static uint8_t job(CORO *c){
+ *       CO_BEGIN(c);
+ *       for(ctx.n=0;ctx.n<3;ctx.n++)
+ *           CO_AWAIT(c, EV_RADIO, 100);
+ *       CO_END(c);
+ *   }
+ *   coroStart(&ctx.co, &job, QP_RADIO);
+ *
+ * A waiting coroutine is not called until one of its events fired or
+ * its timeout passed, c->fired tells which. */
+
+#define EV_TIME   (1<<0)    /* timeout passed */
+#define EV_RADIO  (1<<1)    /* nRF RX FIFO not empty */
+#define EV_BUTTON (1<<2)    /* a button is pressed */
+#define EV_SIGNAL (1<<3)    /* coroSignal(EV_SIGNAL) */
+#define EV_READY  (1<<7)    /* internal: run on the next pass */
+
+#define CO_WAIT 0
+#define CO_DONE 1
+
+typedef struct coro {
+    struct coro *next;
+    uint8_t (*fn)(struct coro *);
+    uint32_t until;
+    uint16_t lc;            /* resume point (__LINE__) */
+    uint8_t wait;           /* events waited for */
+    uint8_t fired;
+    uint8_t prio;
+} CORO;
+
+#define CO_BEGIN(c)  switch((c)->lc){ case 0:
+#define CO_END(c)    }; (c)->lc=0; return CO_DONE
+
+/* Wait for any of ev or ms milliseconds (0: no timeout) */
+#define CO_AWAIT(c,ev,ms) do{ \
+        coro_wait((c),(ev),(ms)); \
+        (c)->lc=__LINE__; return CO_WAIT; case __LINE__:; \
+    }while(0)
+
+#define CO_SLEEP(c,ms) CO_AWAIT(c,0,ms)
+#define CO_YIELD(c)    CO_AWAIT(c,EV_READY,0)
+
+void coroStart(CORO *c, uint8_t (*fn)(CORO *), uint8_t prio);
+void coroStop(CORO *c);
+void coroSignal(uint8_t ev);
+void coroSource(uint8_t ev, uint8_t (*check)(void));
+
+void coro_wait(CORO *c, uint8_t ev, uint32_t ms);
+void coro_poll(void);
+uint32_t coro_deadline(uint32_t max);
+
+#endif
@@ -15,17 +15,58 @@
 #include "ecc.h"
 #include "random.h"
 
-elem_t poly =    {0x8, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x000000c9};
+/* words are stored least significant first, cf. bitstr_getbit() */
+elem_t poly =    {0x000000c9, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x8};
 //bitstr (poly,    "8    00000000    00000000    00000000    00000000    000000c9");
-elem_t coeff_b = {0x2, 0x0a601907, 0xb8c953ca, 0x1481eb10, 0x512f7874, 0x4a3205fd};
+elem_t coeff_b = {0x4a3205fd, 0x512f7874, 0x1481eb10, 0xb8c953ca, 0x0a601907, 0x2};
 //bitstr (coeff_b," 2    0a601907    b8c953ca    1481eb10    512f7874    4a3205fd");
-elem_t base_x =  {0x3, 0xf0eba162, 0x86a2d57e, 0xa0991168, 0xd4994637, 0xe8343e36};
+elem_t base_x =  {0xe8343e36, 0xd4994637, 0xa0991168, 0x86a2d57e, 0xf0eba162, 0x3};
 //    bitstr_parse(base_x,     "3f0eba16286a2d57ea0991168d4994637e8343e36");
-elem_t base_y =  {0x0, 0xd51fbc6c, 0x71a0094f, 0xa2cdd545, 0xb11c5c0c, 0x797324f1};
+elem_t base_y =  {0x797324f1, 0xb11c5c0c, 0xa2cdd545, 0x71a0094f, 0xd51fbc6c, 0x0};
 //    bitstr_parse(base_y,     "0d51fbc6c71a0094fa2cdd545b11c5c0c797324f1");
-elem_t base_order = {0x4, 0x00000000, 0x00000000, 0x000292fe, 0x77e70c12, 0xa4234c33};
+elem_t base_order = {0xa4234c33, 0x77e70c12, 0x000292fe, 0x00000000, 0x00000000, 0x4};
 //bitstr_parse(base_order, "40000000000000000000292fe77e70c12a4234c33");
 
+/* Fixed-base comb table for multiples of (base_x, base_y).
+   Entry i-1 holds sum(2^(j*COMB_SPACING) * base for every bit j set in i).
+   Generated offline with point_double()/point_add() from the values above. */
+#define COMB_TEETH 4
+#define COMB_SPACING ((DEGREE + COMB_TEETH - 1) / COMB_TEETH)
+static const elem_t comb_x[(1 << COMB_TEETH) - 1] = {
+  {0xe8343e36, 0xd4994637, 0xa0991168, 0x86a2d57e, 0xf0eba162, 0x00000003},
+  {0x05fd9372, 0xaa17fdf2, 0x6648e974, 0x31dd5c03, 0x75f1f527, 0x00000002},
+  {0x78a887a6, 0xe478fe58, 0x3d3d2364, 0x3b85b263, 0x34c6885e, 0x00000005},
+  {0x4f685f08, 0x6f8daf88, 0xd1c71b1f, 0x6f4913ff, 0xbaa8682a, 0x00000002},
+  {0xa700c73d, 0x6f842a26, 0xe8f5f5fd, 0x04db6da9, 0x48fcdc95, 0x00000006},
+  {0xeb7ad12e, 0x47e38e87, 0x5f9c4ef1, 0x2fcd5483, 0x3893822e, 0x00000000},
+  {0xa3463d19, 0xaf8c4bb0, 0x2288658a, 0x84b3c40d, 0x90cd449b, 0x00000002},
+  {0x4ab8c649, 0x2fcf02ee, 0x3c7efb85, 0x76f09ad9, 0xdbca45da, 0x00000007},
+  {0x37f9391c, 0xf423fd60, 0xbf079624, 0x4c9036e0, 0x63075e19, 0x00000004},
+  {0xd1acdb88, 0x64ca1fcc, 0x690dfa73, 0xc6708b6f, 0xb44b3919, 0x00000002},
+  {0x9a5c0d6e, 0x4e99152f, 0xaf853232, 0x8db0dccc, 0xef0f58d7, 0x00000005},
+  {0x8670b917, 0x3d61a2ac, 0x6ed8588a, 0x5cc94655, 0x8096413e, 0x00000002},
+  {0x9dd077b2, 0xb2978893, 0x7aa617bb, 0xadbac172, 0xf57da9a2, 0x00000001},
+  {0x43835328, 0xa986d58b, 0x8d7f7c4e, 0xfd642a8d, 0x6d4462d4, 0x00000003},
+  {0x39e10752, 0xde366730, 0xa867db73, 0x5bcb53b5, 0x6b5e56c0, 0x00000003},
+};
+static const elem_t comb_y[(1 << COMB_TEETH) - 1] = {
+  {0x797324f1, 0xb11c5c0c, 0xa2cdd545, 0x71a0094f, 0xd51fbc6c, 0x00000000},
+  {0xdcf990e0, 0x79117c6a, 0x5d2ff662, 0x9865bdb2, 0xb0914960, 0x00000000},
+  {0xef273598, 0xa6d7e436, 0x53001bd9, 0x75cc731c, 0xbf414f74, 0x00000003},
+  {0xd5301336, 0xb4f6dd1e, 0x6454423b, 0x04ebaf45, 0x65c6e401, 0x00000002},
+  {0x1db757cb, 0xb5bf42ba, 0xabfd25b4, 0x466e5be3, 0x2cf27012, 0x00000007},
+  {0x7c98bf09, 0xa41f9589, 0x680ca2a3, 0xdfa83842, 0xedd41659, 0x00000001},
+  {0x6bb4bf11, 0x5e996afa, 0x9b2ae97a, 0xff211307, 0xfbf58239, 0x00000005},
+  {0xeeba93af, 0x59adf276, 0xd25e3760, 0x3292b2c1, 0x271d1b84, 0x00000004},
+  {0xb726dfb5, 0x38c349b3, 0x6e0988b7, 0x87b54141, 0x0cb8d73b, 0x00000002},
+  {0x2b3f67d9, 0xc01ccb1e, 0x5311dcc8, 0xdb9fdd9a, 0x9118031e, 0x00000000},
+  {0x6db63148, 0xefdd7e0a, 0xcc819e67, 0x56a979bc, 0x8d1169b4, 0x00000003},
+  {0xd8715f72, 0xc2ce06e6, 0xd50c5c77, 0x1553a69b, 0x8a20fadc, 0x00000002},
+  {0x6800bbe2, 0x837ad74e, 0xdac7cd95, 0x1082c382, 0xb5ec04b2, 0x00000000},
+  {0xf19901e9, 0x60993930, 0x67c98e9b, 0x1ab9c90d, 0x5d7f4593, 0x00000006},
+  {0xaf59dcaa, 0x8bdbf9ff, 0x2221c861, 0x52b45c1a, 0x221a9b1f, 0x00000006},
+};
+
 
 static unsigned char rnd1()
 {
@@ -331,6 +372,28 @@ static void point_mult(elem_t x, elem_t y, const exp_t exp)
   point_copy(x, y, X, Y);
 }
 
+         /* multiply the base point with 'exp' using the precomputed comb table;
+                                  exponents wider than the comb use point_mult() */
+static void point_mult_base(elem_t x, elem_t y, const exp_t exp)
+{
+  elem_t X, Y;
+  int i, j, idx;
+  if (bitstr_sizeinbits(exp) > COMB_TEETH * COMB_SPACING) {
+    point_copy(x, y, base_x, base_y);
+    point_mult(x, y, exp);
+    return;
+  }
+  point_set_zero(X, Y);
+  for(i = COMB_SPACING - 1; i >= 0; i--) {
+    point_double(X, Y);
+    for(idx = 0, j = COMB_TEETH - 1; j >= 0; j--)
+      idx = (idx << 1) | bitstr_getbit(exp, j * COMB_SPACING + i);
+    if (idx)
+      point_add(X, Y, comb_x[idx - 1], comb_y[idx - 1]);
+  }
+  point_copy(x, y, X, Y);
+}
+
                                /* draw a random value 'exp' with 1 <= exp < n */
 //@@@ Make a HARDWARE randomness generator with ARM, at the moment just a simple pseudorandom replacement
 static void get_random_exponent(exp_t exp)
@@ -424,23 +487,17 @@ static void XTEA_davies_meyer(char *out, const char *in, int ilen)
 }
 
 /******************************************************************************/
-#if 0
-void ECIES_generate_key_pair(void)      /* generate a public/private key pair */
+                                 /* generate a public/private key pair */
+void ECIES_generate_key_pair(uint8_t *Px_exp, uint8_t *Py_exp, uint8_t *k_exp)
 {
-  char buf[8 * NUMWORDS + 1]; *bufptr = buf + NUMWORDS * 8 - (DEGREE + 3) / 4;
   elem_t x, y;
   exp_t k;
   get_random_exponent(k);
-  point_copy(x, y, base_x, base_y);
-  point_mult(x, y, k);
-/*
-  uart0Puts("Here is your new public/private key pair:\n");
-  bitstr_to_hex(buf, x); uart0Puts("Public key: "); uart0Puts(bufptr); uart0Putch(':');
-  bitstr_to_hex(buf, y); uart0Puts(bufptr);
-  bitstr_to_hex(buf, k); uart0Puts("\nPrivate key: "); uart0Puts(bufptr); uart0Putch('\n');
-*/
+  point_mult_base(x, y, k);
+  bitstr_export((char*)Px_exp, x);
+  bitstr_export((char*)Py_exp, y);
+  bitstr_export((char*)k_exp, k);
 }
-#endif
 
        /* check that a given elem_t-pair is a valid point on the curve != 'o' */
 static int ECIES_embedded_public_key_validation(const elem_t Px, const elem_t Py)
@@ -488,8 +545,7 @@ void ECIES_encyptkeygen(uint8_t *px, uint8_t *py,
     point_mult(Zx, Zy, k);
     point_double(Zx, Zy);                           /* cofactor h = 2 on B163 */
   } while(point_is_zero(Zx, Zy));
-  point_copy(Rx, Ry, base_x, base_y);
-  point_mult(Rx, Ry, k);
+  point_mult_base(Rx, Ry, k);
   ECIES_kdf((char *)k1,(char *) k2, Zx, Rx, Ry);
   bitstr_export((char*)Rx_exp, Rx);
   bitstr_export((char*)Ry_exp, Ry);
@@ -532,8 +588,7 @@ void ECIES_encryption(char *msg, const char *text, int len,
     point_mult(Zx, Zy, k);
     point_double(Zx, Zy);                           /* cofactor h = 2 on B163 */
   } while(point_is_zero(Zx, Zy));
-  point_copy(Rx, Ry, base_x, base_y);
-  point_mult(Rx, Ry, k);
+  point_mult_base(Rx, Ry, k);
   ECIES_kdf(k1, k2, Zx, Rx, Ry);
   bitstr_export(msg, Rx);
   bitstr_export(msg + 4 * NUMWORDS, Ry);
@@ -17,6 +17,8 @@ int bitstr_parse_export(char *exp, const char *s);
 
 void ECIES_setup(void);
 
+void ECIES_generate_key_pair(uint8_t *Px_exp, uint8_t *Py_exp, uint8_t *k_exp);
+
 void ECIES_encyptkeygen(uint8_t *px, uint8_t *py, uint8_t k1[16], uint8_t k2[16], uint8_t *Rx_exp, uint8_t *Ry_exp);
 
 int ECIES_decryptkeygen(uint8_t *rx, uint8_t *ry, uint8_t k1[16], uint8_t k2[16], const char *privkey);
@@ -1,55 +1,285 @@
 #include <sysinit.h>
 
 #include "basic/basic.h"
+#include "lcd/display.h"
 #include "lcd/print.h"
+#include "core/pmu/pmu.h"
 
 QUEUE the_queue;
+volatile uint32_t _timewraps=0;
 #ifdef __arm__
 volatile uint32_t _timectr=0;
+static volatile uint32_t idle_rest; /* us slept that did not make a whole tick */
 #else
-extern uint32_t simTimeCounter();
-#define _timectr (simTimeCounter())
+extern uint64_t simMicroCounter();
+extern void simIdleSleep(uint32_t ticks);
 #endif
 
+/* Microseconds since boot: whole ticks, what tickless sleeps left
+ * over below a tick, and how far the systick has counted into the
+ * current one. Safe to call from interrupts. */
+uint64_t getMicros(void){
+#ifdef __arm__
+    uint32_t hi, ticks, cur, reload, rest;
+    uint8_t pend;
+
+    do{
+        hi=_timewraps;
+        ticks=_timectr;
+        rest=idle_rest;
+        cur=SYSTICK_STCURR;
+        pend=(SYSTICK_ICSR & SYSTICK_ICSR_PENDSTSET)!=0;
+    }while(ticks!=_timectr || hi!=_timewraps || rest!=idle_rest);
+
+    reload=SYSTICK_STRELOAD+1;
+    /* the counter reloaded, but the tick was not counted yet */
+    if(pend && cur>reload/2)
+        if(!++ticks)
+            hi++;
+    return (((uint64_t)hi<<32)|ticks)*(SYSTICKSPEED*1000) + rest
+        + (reload-1-cur)/(CFG_CPU_CCLK/1000000);
+#else
+    return simMicroCounter();
+#endif
+};
+
 /**************************************************************************/
 
+/* Entries may be pushed from interrupt context, so the lists are only
+ * touched with interrupts off. */
+
+static QTIMER *wheel[TW_SLOTS];
+static uint32_t tw_last;
+
+static int queue_add(uint8_t prio, uint8_t type, void *fn){
+    uint8_t i;
+    QENTRY *e;
+
+    for(i=0;i<MAXQENTRIES;i++)
+        if(!the_queue.queue[i].u.callback)
+            break;
+    if(i==MAXQENTRIES){
+        the_queue.dropped++;
+        return -1;
+    };
+
+    e=&the_queue.queue[i];
+    if(type==QT_PLUS)
+        e->u.callbackplus=fn;
+    else
+        e->u.callback=fn;
+    e->type=type;
+    e->state=QS_START;
+    e->next=0;
+    if(the_queue.tail[prio])
+        the_queue.queue[the_queue.tail[prio]-1].next=i+1;
+    else
+        the_queue.head[prio]=i+1;
+    the_queue.tail[prio]=i+1;
+    the_queue.depth++;
+    return 0;
+};
+
+static void queue_pop(uint8_t prio){
+    QENTRY *e;
+
+    __disable_irq();
+    e=&the_queue.queue[the_queue.head[prio]-1];
+    the_queue.head[prio]=e->next;
+    if(!e->next)
+        the_queue.tail[prio]=0;
+    e->u.callback=NULL;
+    the_queue.depth--;
+    __enable_irq();
+};
+
+static void timer_link(QTIMER *t){
+    QTIMER **slot=&wheel[t->expires%TW_SLOTS];
+
+    t->next=*slot;
+    *slot=t;
+};
+
+static void timer_unlink(QTIMER *t){
+    QTIMER **p;
+
+    for(p=&wheel[t->expires%TW_SLOTS];*p;p=&(*p)->next)
+        if(*p==t){
+            *p=t->next;
+            break;
+        };
+};
+
+/* Push the timers of one slot that are due. If the queue is full
+ * they stay armed and are retried when the slot comes round again. */
+static void timer_slot(uint8_t slot, uint32_t now){
+    QTIMER **p=&wheel[slot], *t;
+
+    while((t=*p)){
+        if((int32_t)(t->expires-now)>0 || queue_add(t->prio, t->type, t->u.callback)){
+            p=&t->next;
+            continue;
+        };
+        *p=t->next;
+        if(t->period){
+            t->expires+=t->period;
+            if((int32_t)(t->expires-now)<=0)
+                t->expires=now+t->period;
+            timer_link(t);
+        }else{
+            t->armed=0;
+        };
+    };
+};
+
+static void timer_run(void){
+    uint32_t now=getTimer();
+    uint32_t tick;
+
+    if(now==tw_last)
+        return;
+    tick=now-tw_last>TW_SLOTS ? now-TW_SLOTS : tw_last;
+    tw_last=now;
+    while(tick++!=now){
+        __disable_irq();
+        timer_slot(tick%TW_SLOTS, now);
+        __enable_irq();
+    };
+};
+
+/* Start (or restart) t to expire in ms. Also callable with interrupts
+ * off, which it leaves off. */
+void timerStart(QTIMER *t, uint32_t ms){
+    uint32_t mask=__get_PRIMASK();
+
+    __disable_irq();
+    if(t->armed)
+        timer_unlink(t);
+    t->expires=getTimer()+(ms+SYSTICKSPEED-1)/SYSTICKSPEED;
+    if((int32_t)(t->expires-tw_last)<=0)   /* slot already passed */
+        t->expires=tw_last+1;
+    t->armed=1;
+    timer_link(t);
+    __set_PRIMASK(mask);
+};
+
+void timerStop(QTIMER *t){
+    uint32_t mask=__get_PRIMASK();
+
+    __disable_irq();
+    if(t->armed)
+        timer_unlink(t);
+    t->armed=0;
+    __set_PRIMASK(mask);
+};
+
+/* Ticks until the next timer expires, at most max */
+static uint32_t timer_deadline(uint32_t max){
+    uint32_t now=getTimer();
+    QTIMER *t;
+    uint8_t i;
+
+    for(i=0;i<TW_SLOTS;i++)
+        for(t=wheel[i];t;t=t->next){
+            if((int32_t)(t->expires-now)<=0)
+                return 0;
+            if(t->expires-now<max)
+                max=t->expires-now;
+        };
+    return max;
+};
+
+/* Tickless idle: if nothing is due for IDLE_MINSLEEP ticks, stop the
+ * systick and sleep until the next deadline, but at most ticks and
+ * IDLE_MAXSLEEP. Button interrupts end the sleep early. Afterwards the
+ * tick hooks are run once for every tick slept through, so they (and
+ * _timectr, which tick_default counts) see time pass as if the systick
+ * had kept running, just in a burst. */
+#define IDLE_MINSLEEP 3
+#define IDLE_MAXSLEEP 100
+
+#ifdef __arm__
+void tick_wrapper(void);
+#endif
+
+static void idle(int32_t ticks){
+    if(ticks>IDLE_MAXSLEEP)
+        ticks=IDLE_MAXSLEEP;
+    if(ticks>0)
+        ticks=lcd_deadline(key_deadline(coro_deadline(timer_deadline(ticks))));
+    if(ticks<IDLE_MINSLEEP){
+        WFI;
+        return;
+    };
+#ifdef __arm__
+    uint32_t us;
 
+    /* Interrupts may have queued work or signalled since we looked.
+     * Look again with them off; one coming in from now on ends the
+     * sleep at once. */
+    __disable_irq();
+    if(the_queue.depth ||
+            lcd_deadline(key_deadline(coro_deadline(ticks)))<IDLE_MINSLEEP){
+        __enable_irq();
+        return;
+    };
+    us=pmuSleepTickless(ticks*SYSTICKSPEED*1000)+idle_rest;
+    for(ticks=us/(SYSTICKSPEED*1000);ticks>0;ticks--)
+        tick_wrapper();
+    idle_rest=us%(SYSTICKSPEED*1000);
+    __enable_irq();
+#else
+    simIdleSleep(ticks);
+#endif
+};
+
+static uint8_t queue_empty(void){
+    timer_run();
+    coro_poll();
+    return !the_queue.depth;
+};
+
+/* Run the oldest entry of the most urgent class. Returns 1 if it was
+ * a QT_PLUS entry that wants to be called again. */
 uint8_t work_queue_minimal(void){
-	int start;
+    uint8_t prio;
+    QENTRY *e;
 
-	if (the_queue.qstart == the_queue.qend){
-		return 0;
-	};
+    if(queue_empty())
+        return 0;
 
-	start=the_queue.qstart;
-	start=(start+1)%MAXQENTRIES;
-    if(the_queue.queue[start].type == QT_NORMAL){
+    for(prio=0;!the_queue.head[prio];prio++)
+        ;
+    e=&the_queue.queue[the_queue.head[prio]-1];
+    if(e->type == QT_NORMAL){
         void (*elem)(void);
-        elem=the_queue.queue[start].u.callback;
-        the_queue.qstart=start;
+        elem=e->u.callback;
+        queue_pop(prio);
+        TRACE_BEGIN(TR_WORK,(uintptr_t)elem);
         elem();
+        TRACE_END(TR_WORK,(uintptr_t)elem);
         return 0;
-    }else if(the_queue.queue[start].type == QT_PLUS){
+    }else{
         uint8_t (*elem)(uint8_t);
-        uint8_t state=the_queue.queue[start].state;
-        elem=the_queue.queue[start].u.callbackplus;
+        uint8_t state=e->state;
+        elem=e->u.callbackplus;
+        TRACE_BEGIN(TR_WORK,(uintptr_t)elem);
         state=elem(state);
+        TRACE_END(TR_WORK,(uintptr_t)elem);
         if(state==QS_END){
-            the_queue.qstart=start;
+            queue_pop(prio);
             return 0;
         }else{
-            the_queue.queue[start].state=state;
+            e->state=state;
             return 1;
         };
     };
-    /* NOTREACHED */
-    return 0;
 };
 
 void work_queue(void){
 
-	if (the_queue.qstart == the_queue.qend){
-        WFI;
+	if (queue_empty()){
+        idle(IDLE_MAXSLEEP);
         return;
 	};
 
@@ -59,14 +289,14 @@ void work_queue(void){
 
 uint8_t delayms_queue_plus(uint32_t ms, uint8_t final){
     int ret=0;
-    int end=_timectr+ms/SYSTICKSPEED;
+    int end=getTimer()+ms/SYSTICKSPEED;
     do {
-        if (the_queue.qstart == the_queue.qend){
-            WFI;
+        if (queue_empty()){
+            idle(end-getTimer());
         }else{
             ret=work_queue_minimal();
         };
-    } while (end >_timectr);
+    } while (end >getTimer());
     if(ret && final){
         while(work_queue_minimal());
     };
@@ -74,53 +304,48 @@ uint8_t delayms_queue_plus(uint32_t ms, uint8_t final){
 };
 
 void delayms_queue(uint32_t ms){
-	int end=_timectr+ms/SYSTICKSPEED;
+	int end=getTimer()+ms/SYSTICKSPEED;
 	do {
-		if (the_queue.qstart == the_queue.qend){
-            WFI;
+		if (queue_empty()){
+            idle(end-getTimer());
 		}else{
 			work_queue();
 		};
-	} while (end >_timectr);
+	} while (end >getTimer());
 };
 
 void delayms_power(uint32_t ms){
     ms/=SYSTICKSPEED;
-    ms+=_timectr;
+    ms+=getTimer();
 	do {
-        WFI;
-	} while (ms >_timectr);
+        idle(ms-getTimer());
+	} while (ms >getTimer());
 };
 
-int push_queue(void (*new)(void)){
-	int end;
+int push_queue_prio(void (*new)(void), uint8_t prio){
+    uint32_t mask=__get_PRIMASK();
+    int ret;
 
-	end=the_queue.qend;
-	end=(end+1)%MAXQENTRIES;
+    __disable_irq();
+    ret=queue_add(prio, QT_NORMAL, new);
+    __set_PRIMASK(mask);
+    return ret;
+};
 
-	if(end == the_queue.qstart) // Queue full
-		return -1;
+int push_queue_plus_prio(uint8_t (*new)(uint8_t), uint8_t prio){
+    uint32_t mask=__get_PRIMASK();
+    int ret;
 
-	the_queue.queue[end].u.callback=new;
-	the_queue.queue[end].type=QT_NORMAL;
-	the_queue.qend=end;
+    __disable_irq();
+    ret=queue_add(prio, QT_PLUS, new);
+    __set_PRIMASK(mask);
+    return ret;
+};
 
-	return 0;
+int push_queue(void (*new)(void)){
+    return push_queue_prio(new, QP_BACKGROUND);
 };
 
 int push_queue_plus(uint8_t (*new)(uint8_t)){
-	int end;
-
-	end=the_queue.qend;
-	end=(end+1)%MAXQENTRIES;
-
-	if(end == the_queue.qstart) // Queue full
-		return -1;
-
-	the_queue.queue[end].u.callbackplus=new;
-	the_queue.queue[end].type=QT_PLUS;
-	the_queue.queue[end].state=QS_START;
-	the_queue.qend=end;
-
-	return 0;
+    return push_queue_plus_prio(new, QP_BACKGROUND);
 };
@@ -1,13 +1,20 @@
 #ifndef __BASICIDLE_H_
 #define __BASICIDLE_H_
 
-#define MAXQENTRIES 8
+#define MAXQENTRIES 16
 
 #define QT_NORMAL 0
 #define QT_PLUS   1
 #define QS_START 0x0
 #define QS_END   0x7f
 
+/* Priority classes, the lowest number with work pending runs first */
+#define QP_UI         0
+#define QP_RADIO      1
+#define QP_STORAGE    2
+#define QP_BACKGROUND 3
+#define QPRIOS        4
+
 typedef struct {
     union {
         void (*callback)(void);
@@ -15,16 +22,40 @@ typedef struct {
     } u;
     unsigned type  :1;
     unsigned state :7;
+    uint8_t next;           /* index+1 of the next entry, 0: end */
 } QENTRY;
 
+/* One FIFO per class, linked through a shared pool of entries.
+ * Unused entries have no callback. */
 typedef struct {
-    int qstart;
-    int qend;
+    uint8_t head[QPRIOS];   /* index+1, 0: empty */
+    uint8_t tail[QPRIOS];
+    uint8_t depth;
+    uint8_t dropped;        /* pushes that failed because the pool was full */
     QENTRY queue[MAXQENTRIES];
 } QUEUE;
 
+/* Delayed and periodic work, hashed by expiry tick into TW_SLOTS lists.
+ * The timer is owned by the caller; when it expires its callback is
+ * pushed with its priority. period is in ticks, 0 for one-shot. */
+#define TW_SLOTS 8
+
+typedef struct qtimer {
+    struct qtimer *next;
+    uint32_t expires;
+    uint16_t period;
+    uint8_t prio;
+    unsigned type  :1;
+    unsigned armed :1;
+    union {
+        void (*callback)(void);
+        uint8_t (*callbackplus)(uint8_t);
+    } u;
+} QTIMER;
+
 extern QUEUE the_queue;
 extern volatile uint32_t _timectr;
+extern volatile uint32_t _timewraps;
 
 void work_queue(void);
 uint8_t work_queue_minimal(void);
@@ -33,12 +64,24 @@ uint8_t delayms_queue_plus(uint32_t, uint8_t);
 void delayms_power(uint32_t);
 int push_queue(void (*qnew)(void));
 int push_queue_plus(uint8_t (*qnew)(uint8_t));
+int push_queue_prio(void (*qnew)(void), uint8_t prio);
+int push_queue_plus_prio(uint8_t (*qnew)(uint8_t), uint8_t prio);
+void timerStart(QTIMER *t, uint32_t ms);
+void timerStop(QTIMER *t);
 
 // Note: 
-// Our time implementation will fail after 497 days of continous uptime.
+// _timectr wraps after 497 days of continous uptime.
 // ( 2^32 / 1000 * SYSTICKSPEED ) seconds
+// _timewraps counts the wraps, getMicros() does not fail.
 
-#define incTimer(void) do{_timectr++;}while(0);
+#define incTimer(void) do{if(!++_timectr)_timewraps++;}while(0);
+#ifdef __arm__
 #define getTimer() (_timectr)
+#else
+/* The simulator has no systick, see simcore/timecounter.c */
+uint32_t simTimeCounter(void);
+#define getTimer() (simTimeCounter())
+#endif
+uint64_t getMicros(void);
 
 #endif
@@ -1,5 +1,23 @@
 #include <sysinit.h>
 #include "basic/basic.h"
+#include "core/gpio/gpio.h"
+
+/* Button changes come from the pin interrupts (on the simulator, and
+ * before keyInit(), from polling in key_sync()) and are queued as
+ * timestamped events. A change within KEY_DEBOUNCE ticks of the last
+ * one is bounce; key_sync() looks at the pins again once that passed. */
+
+#define KEY_EVENTS   8
+#define KEY_DEBOUNCE 2
+#define KEY_MAXAGE   (500/SYSTICKSPEED)  /* older presses are stale */
+
+static KEYEVENT key_ring[KEY_EVENTS];
+static volatile uint8_t key_head, key_tail;
+static volatile uint8_t key_state;      /* debounced */
+static uint32_t key_changed;
+static uint32_t key_next;               /* next repeat */
+static uint8_t key_repeats;
+static uint8_t key_irq;
 
 uint8_t getInputRaw(void) {
     uint8_t result = BTN_NONE;
@@ -27,16 +45,151 @@ uint8_t getInputRaw(void) {
     return result;
 }
 
+static void key_push(uint8_t type, uint8_t key, uint32_t time){
+    uint8_t next=(key_head+1)%KEY_EVENTS;
+    KEYEVENT *e;
+
+    /* a repeat not picked up yet is just moved */
+    if(type==KEY_REPEAT && key_head!=key_tail){
+        e=&key_ring[(key_head+KEY_EVENTS-1)%KEY_EVENTS];
+        if(e->type==KEY_REPEAT && e->key==key){
+            e->time=time;
+            return;
+        };
+    };
+    if(next==key_tail)
+        return;
+    e=&key_ring[key_head];
+    e->time=time;
+    e->key=key;
+    e->type=type;
+    key_head=next;
+}
+
+static uint16_t key_delay(uint8_t repeats){
+    if(repeats<5)
+        return 250;
+    if(repeats<25)
+        return 150;
+    if(repeats<50)
+        return 80;
+    return 20;
+}
+
+/* with interrupts off */
+static void key_update(uint32_t now){
+    uint8_t raw=getInputRaw();
+    uint8_t diff=raw^key_state;
+
+    if(!diff || now-key_changed<KEY_DEBOUNCE)
+        return;
+    key_changed=now;
+    if(key_state & diff)
+        key_push(KEY_RELEASE, key_state & diff, now);
+    if(raw & diff){
+        key_push(KEY_PRESS, raw, now);
+        key_repeats=0;
+        key_next=now+600/SYSTICKSPEED;
+        coroSignal(EV_BUTTON);
+    };
+    key_state=raw;
+}
+
+static const uint8_t key_pins[]={RB_BTN0, RB_BTN1, RB_BTN2, RB_BTN3, RB_BTN4};
+
+/* Pin interrupt of a button. Port 3 is shared with the bus interrupt,
+ * its handler in basic.c calls this for RB_BTN3. */
+void key_irqhandler(void){
+    uint8_t i;
+
+    for(i=0;i<sizeof(key_pins);i+=2)
+        if(gpioIntStatus(key_pins[i], key_pins[i+1]))
+            gpioIntClear(key_pins[i], key_pins[i+1]);
+    key_update(getTimer());
+}
+
+#ifdef __arm__
+void PIOINT0_IRQHandler(void){ key_irqhandler(); }
+void PIOINT2_IRQHandler(void){ key_irqhandler(); }
+#endif
+
+/* Interrupt on both edges of all buttons */
+void keyInit(void){
+#ifdef __arm__
+    uint8_t i;
+
+    for(i=0;i<sizeof(key_pins);i+=2){
+        gpioSetInterrupt(key_pins[i], key_pins[i+1], gpioInterruptSense_Edge,
+                gpioInterruptEdge_Double, gpioInterruptEvent_ActiveLow);
+        gpioIntClear(key_pins[i], key_pins[i+1]);
+        gpioIntEnable(key_pins[i], key_pins[i+1]);
+    };
+    key_irq=1;
+    coroSource(EV_BUTTON, NULL);
+#endif
+    key_state=getInputRaw();
+}
+
+/* Catch up on what the interrupts cannot see: the end of a bounce,
+ * key repeat and, without interrupts, everything. */
+void key_sync(void){
+    uint32_t now=getTimer();
+    uint32_t mask=__get_PRIMASK();
+
+    __disable_irq();
+    key_update(now);
+    if(key_state && (int32_t)(now-key_next)>=0){
+        key_push(KEY_REPEAT, key_state, now);
+        key_next=now+key_delay(key_repeats++)/SYSTICKSPEED;
+    };
+    __set_PRIMASK(mask);
+}
+
+/* Ticks the idle loop may sleep without missing a key change */
+uint32_t key_deadline(uint32_t max){
+    key_sync();
+    if(key_state || getInputRaw()!=key_state)
+        return KEY_DEBOUNCE<max ? KEY_DEBOUNCE : max;
+    if(!key_irq && max>10)
+        return 10;
+    return max;
+}
+
+/* Oldest queued event, 0 if there is none */
+uint8_t keyGetEvent(KEYEVENT *ev){
+    key_sync();
+    if(key_head==key_tail)
+        return 0;
+    *ev=key_ring[key_tail];
+    key_tail=(key_tail+1)%KEY_EVENTS;
+    return 1;
+}
+
+uint8_t keyState(void){
+    key_sync();
+    return key_state;
+}
+
+/* Next press (or repeat) newer than KEY_MAXAGE, BTN_NONE if none */
+static uint8_t key_nextpress(uint8_t repeat){
+    KEYEVENT ev;
+
+    while(keyGetEvent(&ev)){
+        if(ev.type==KEY_RELEASE || (ev.type==KEY_REPEAT && !repeat))
+            continue;
+        if(getTimer()-ev.time>KEY_MAXAGE)
+            continue;
+        return ev.key;
+    };
+    return BTN_NONE;
+}
+
 uint8_t getInput(void) {
     uint8_t key = BTN_NONE;
 
-    key=getInputRaw();
-    /* XXX: we should probably debounce the joystick.
-            Any ideas how to do this properly?
-            For now wait for any release.
-     */
+    key=keyState();
     if(key != BTN_NONE)
-        while(key==getInputRaw())
+        while(key==keyState())
             work_queue();
 
     return key;
@@ -44,9 +197,8 @@ uint8_t getInput(void) {
 
 uint8_t getInputWait(void) {
     uint8_t key;
-    while ((key=getInputRaw())==BTN_NONE)
+    while ((key=key_nextpress(0))==BTN_NONE)
         work_queue();
-    delayms_queue(10); /* Delay a little more to debounce */
     return key;
 };
 
@@ -54,55 +206,31 @@ uint8_t getInputWaitTimeout(int timeout) {
     uint8_t key;
     if(timeout==0)
         return getInputWait();
-    int end=_timectr+timeout/SYSTICKSPEED;
-    while ((key=getInputRaw())==BTN_NONE){
-        if(_timectr>end)
+    int end=getTimer()+timeout/SYSTICKSPEED;
+    while ((key=key_nextpress(0))==BTN_NONE){
+        if(getTimer()>end)
             break;
         work_queue();
     };
-    delayms_queue(10); /* Delay a little more to debounce */
     return key;
 };
 
 uint8_t getInputWaitRepeat(void) {
-    static uint8_t oldkey=BTN_NONE;
-    static int repeatctr=0;
-    uint8_t key=getInputRaw();
-
-    if (key != BTN_NONE && key==oldkey){
-        int dtime;
-        if(!repeatctr)
-            dtime=600;
-        else if(repeatctr<5)
-            dtime=250;
-        else if(repeatctr<25)
-            dtime=150;
-        else if(repeatctr<50)
-            dtime=80;
-        else
-            dtime=20;
-        repeatctr++;
-        int end=_timectr+(dtime/SYSTICKSPEED);
-        while(_timectr<end && key==getInputRaw())
-            work_queue();
-        key=getInputRaw();
-        if (key==oldkey)
-            return key;
-    };
-
-    repeatctr=0;
-    while ((key=getInputRaw())==BTN_NONE){
+    uint8_t key;
+    while ((key=key_nextpress(1))==BTN_NONE)
         work_queue();
-    };
-    delayms_queue(10); /* Delay a little more to debounce */
-    oldkey=key;
     return key;
 };
 
+/* The caller saw the key via keyState()/getInputRaw(), so what the
+ * ring holds up to the release is already handled. */
 void getInputWaitRelease(void) {
-    while (getInputRaw()!=BTN_NONE)
+    uint32_t mask;
+
+    while (keyState()!=BTN_NONE)
         work_queue();
-    delayms_queue(10); /* Delay a little more to debounce */
+    mask=__get_PRIMASK();
+    __disable_irq();
+    key_tail=key_head;
+    __set_PRIMASK(mask);
 };
-
-
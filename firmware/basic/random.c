@@ -1,27 +1,79 @@
 #include <stdint.h>
+#include <string.h>
 #include "random.h"
 #include "xxtea.h"
+#include "uuid.h"
 #include "core/adc/adc.h"
 
+/* Entropy is mixed into the pool cheaply (also from interrupt context)
+ * via randomAddEntropy(). Output comes from xxtea in counter mode; the
+ * generator key is rederived from the pool whenever fresh entropy
+ * arrived since the last rekey. */
+
 #define STATE_SIZE  8
+#define BLOCK_SIZE  4
+#define INIT_SAMPLES 64
+
 uint32_t state[STATE_SIZE];
 uint32_t const I[4] = {12,13,14,15};
 
+static uint32_t key[4];
+static uint32_t block[BLOCK_SIZE];
+static uint32_t ctr;
+static uint8_t avail;
+static volatile uint8_t pos;
+static volatile uint8_t fresh;
+
+void randomAddEntropy(uint32_t x)
+{
+    uint8_t p=pos;
+    state[p] = ((state[p]<<7) | (state[p]>>25)) ^ x;
+    pos = (p+1)%STATE_SIZE;
+    fresh=1;
+}
+
+static void randomRekey(void)
+{
+    uint32_t tmp[STATE_SIZE];
+
+    fresh=0;
+    memcpy(tmp, state, sizeof(tmp));
+    xxtea_encode_words(tmp, STATE_SIZE, key);
+    memcpy(key, tmp, sizeof(key));
+    avail=0;
+}
+
+void randomSeed(uint32_t seed)
+{
+    uint32_t i;
+    for(i=0; i<STATE_SIZE; i++)
+        state[i] = seed+i;
+    memcpy(key, I, sizeof(key));
+    ctr=0;
+    pos=0;
+    randomRekey();
+}
+
 void randomInit(void)
 {
-    uint32_t i,j,x;
-    for(j=0; j<STATE_SIZE; j++){
-        x = 0;
-        for(i=0; i<10240; i++){
-            x ^= (adcRead(1)&1)<<(i%32);
-        }
-        state[j] = x;
-    }
-    xxtea_encode_words(state, STATE_SIZE, I);
+    uint32_t i;
+
+    memcpy(key, I, sizeof(key));
+    randomAddEntropy(GetUUID32());
+    for(i=0; i<INIT_SAMPLES; i++)
+        randomAddEntropy(adcRead(1));
+    randomRekey();
 }
 
 uint32_t getRandom(void)
 {
-    xxtea_encode_words(state, STATE_SIZE, I);
-    return state[0];
+    if(!avail){
+        if(fresh)
+            randomRekey();
+        memset(block, 0, sizeof(block));
+        block[0]=ctr++;
+        xxtea_encode_words(block, BLOCK_SIZE, key);
+        avail=BLOCK_SIZE;
+    }
+    return block[--avail];
 }
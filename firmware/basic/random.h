@@ -2,6 +2,8 @@
 #define _RANDOM_H_
 #include <stdint.h>
 void randomInit(void);
+void randomSeed(uint32_t seed);
+void randomAddEntropy(uint32_t x);
 uint32_t getRandom(void);
 
 #endif
@@ -50,8 +50,124 @@ struct tm * mygmtime(register const time_t time) {
         return timep;
 }
 
+/* Time sync. The clock is _timet seconds plus the uptime plus a
+ * correction that follows the peers without stepping:
+ *   ts.adj + dt*ts.freq/2^24 + min(dt/2^TS_SLEWSHIFT, ts.slew)
+ * where dt is the uptime since the last sample.
+ *
+ * Each measured error is slewed in over TS_TAU, independent of how
+ * many peers are heard. ts.freq is the skew of our crystal against the
+ * mesh. It is learned from the rate clock (uptime corrected by freq
+ * only, never slewed) of one peer sampled TS_FREQDT apart, so that a
+ * constant latency error cannot feed back into the skew. */
+#define TS_STEP       2000000   /* larger errors are stepped, us */
+#define TS_SANE       100000    /* larger errors do not train the skew */
+#define TS_TAU        64000000  /* phase time constant, us */
+#define TS_SLEWSHIFT  11        /* slew at most 1/2048 (488ppm) */
+#define TS_FREQDT     256000000 /* skew estimation window, us */
+#define TS_MAXFREQ    8389      /* 500ppm in 2^-24 */
+
+static struct {
+    uint64_t up;        /* uptime of the last sample */
+    int64_t adj;        /* correction at up */
+    int32_t slew;       /* correction still to be applied */
+    int32_t freq;
+    uint64_t rup;       /* rate clock: rbase at uptime rup */
+    uint64_t rbase;
+    uint32_t peer;      /* skew window: peer, its rate clock and our */
+    uint32_t prate;     /* uptime at the start */
+    uint64_t pup;
+} ts;
+
+static int64_t time_adj(uint64_t up){
+    int64_t dt=up>ts.up ? up-ts.up : 0;
+    int64_t adj=ts.adj+((dt*ts.freq)>>24);
+    int64_t s=dt>>TS_SLEWSHIFT;
+
+    if(ts.slew>=0)
+        adj+= s<ts.slew ? s : ts.slew;
+    else
+        adj-= s<-ts.slew ? s : -ts.slew;
+    return adj;
+};
+
+static uint64_t time_rate(uint64_t up){
+    int64_t dt=up-ts.rup;
+    return ts.rbase+dt+((dt*ts.freq)>>24);
+};
+
+/* Corrected microseconds since the epoch */
+int64_t getMicrosWall(void){
+    uint64_t up=getMicros();
+    return (int64_t)_timet*1000000+up+time_adj(up);
+};
+
+/* Uptime corrected for the skew only, for timeSync() of our peers */
+uint32_t getMicrosRate(void){
+    return time_rate(getMicros());
+};
+
+/* Forget the correction, but keep the skew of our crystal */
+void timeReset(void){
+    ts.adj=ts.slew=0;
+    ts.up=0;
+};
+
+static void time_freq(uint32_t peer, uint32_t rate, uint64_t up){
+    uint64_t dt=up-ts.pup;
+    int32_t f;
+
+    if(!ts.pup || dt>2*(uint64_t)TS_FREQDT){
+        ts.peer=peer;
+        ts.prate=rate;
+        ts.pup=up;
+        return;
+    };
+    if(peer!=ts.peer || dt<TS_FREQDT)
+        return;
+
+    f=((int64_t)(rate-ts.prate)-(int64_t)dt)*(1<<24)/(int64_t)dt;
+    ts.rbase=time_rate(up);
+    ts.rup=up;
+    ts.freq+=(f-ts.freq)/4;
+    if(ts.freq>TS_MAXFREQ)
+        ts.freq=TS_MAXFREQ;
+    if(ts.freq<-TS_MAXFREQ)
+        ts.freq=-TS_MAXFREQ;
+    ts.prate=rate;
+    ts.pup=up;
+};
+
+/* A peer's clock read remote (us since the epoch) and its rate clock
+ * rate at our uptime up. peer identifies it, 0 if it cannot be told
+ * apart or sends no rate. Returns 1 if the clock was stepped. Clocks
+ * behind ours are only followed while they are close: do not live in
+ * the past. */
+uint8_t timeSync(int64_t remote, uint32_t rate, uint32_t peer, uint64_t up){
+    int64_t err=remote-(int64_t)_timet*1000000-(int64_t)up-time_adj(up);
+    uint64_t dt=up>ts.up ? up-ts.up : 0;
+
+    if(err<-TS_STEP)
+        return 0;
+
+    ts.adj=time_adj(up);
+    ts.up=up;
+    if(err>TS_STEP){
+        ts.adj+=err;
+        ts.slew=0;
+        return 1;
+    };
+    if(dt>TS_TAU)
+        dt=TS_TAU;
+    ts.slew=err*(int64_t)dt/TS_TAU;
+
+    if(peer && err<TS_SANE && err>-TS_SANE)
+        time_freq(peer, rate, up);
+    return 0;
+};
+
 // Timezones suck. Currently we only do it all in localtime.
 // I know it's broken. Sorry
 time_t getSeconds(void){
-    return _timet+(getTimer()*SYSTICKSPEED/1000);
+    return getMicrosWall()/1000000;
 };
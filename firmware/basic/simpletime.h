@@ -2,6 +2,7 @@
 #define __SIMPLETIME_H_
 
 #include <time.h>
+#include <stdint.h>
 
 #define YEAR0           1900                    /* the first year */
 #define EPOCH_YR        1970            /* EPOCH = Jan 1 1970 00:00:00 */
@@ -12,5 +13,9 @@
 extern time_t _timet;
 struct tm * mygmtime(register const time_t time);
 time_t getSeconds(void);
+int64_t getMicrosWall(void);
+uint32_t getMicrosRate(void);
+uint8_t timeSync(int64_t remote, uint32_t rate, uint32_t peer, uint64_t up);
+void timeReset(void);
 
 #endif
@@ -0,0 +1,61 @@
+#include <sysinit.h>
+#include "basic/basic.h"
+
+/* The stack grows down from stack_entry towards the end of .bss, with
+ * nothing in between. stackPaint() fills that gap with STACK_PAINT at
+ * boot; the lowest word no longer holding it is the deepest the stack
+ * (including l0dables and interrupts) ever went. */
+
+#define STACK_PAINT  0xc5c5c5c5
+#define STACK_MARGIN 32     /* left unpainted below the caller's frame */
+
+#ifdef __arm__
+extern unsigned char _data;
+extern unsigned char _ebss;
+extern unsigned char stack_entry;
+
+#define STACK_BOTTOM ((uint32_t *)(((uint32_t)&_ebss+3)&~3))
+#define STACK_TOP    ((uint32_t *)&stack_entry)
+
+/* Call first thing in main(), before anything deep runs */
+void stackPaint(void){
+    uint32_t *p, *sp;
+
+    __asm volatile ("mov %0, sp\n" : "=r" (sp));
+    for(p=STACK_BOTTOM;p<sp-STACK_MARGIN/4;p++)
+        *p=STACK_PAINT;
+}
+
+uint32_t stackSize(void){
+    return (uint8_t *)STACK_TOP-(uint8_t *)STACK_BOTTOM;
+}
+
+/* High-water mark in bytes */
+uint32_t stackUsed(void){
+    uint32_t *p;
+
+    for(p=STACK_BOTTOM;p<STACK_TOP && *p==STACK_PAINT;p++)
+        ;
+    return (uint8_t *)STACK_TOP-(uint8_t *)p;
+}
+
+/* .data and .bss */
+uint32_t ramStatic(void){
+    return &_ebss-&_data;
+}
+#else
+void stackPaint(void){
+}
+
+uint32_t stackSize(void){
+    return 0;
+}
+
+uint32_t stackUsed(void){
+    return 0;
+}
+
+uint32_t ramStatic(void){
+    return 0;
+}
+#endif
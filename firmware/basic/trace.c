@@ -0,0 +1,74 @@
+#include <sysinit.h>
+#include "basic/basic.h"
+#include "basic/trace.h"
+
+/* Once full, the oldest events are overwritten. Events may come from
+ * interrupts. */
+
+#if CFG_TRACE
+static TRACEEVENT trace_ring[CFG_TRACE];
+static uint16_t trace_head;
+static uint16_t trace_count;
+static uint8_t trace_off;
+
+void traceEvent(uint8_t id, uint16_t arg){
+    TRACEEVENT *e;
+    uint32_t now=getMicros();
+    uint32_t mask;
+
+    if(trace_off)
+        return;
+    mask=__get_PRIMASK();
+    __disable_irq();
+    e=&trace_ring[trace_head];
+    trace_head=(trace_head+1)%CFG_TRACE;
+    if(trace_count<CFG_TRACE)
+        trace_count++;
+    e->time=now;
+    e->id=id;
+    e->pad=0;
+    e->arg=arg;
+    __set_PRIMASK(mask);
+};
+
+void traceEnable(uint8_t on){
+    trace_off=!on;
+};
+
+uint16_t traceCount(void){
+    return trace_count;
+};
+
+/* Event i, counted from the oldest. Disable tracing while reading. */
+uint8_t traceRead(uint16_t i, TRACEEVENT *ev){
+    if(i>=trace_count)
+        return 0;
+    *ev=trace_ring[(trace_head+CFG_TRACE-trace_count+i)%CFG_TRACE];
+    return 1;
+};
+
+void traceClear(void){
+    uint32_t mask=__get_PRIMASK();
+
+    __disable_irq();
+    trace_head=trace_count=0;
+    __set_PRIMASK(mask);
+};
+#else
+void traceEvent(uint8_t id, uint16_t arg){
+};
+
+void traceEnable(uint8_t on){
+};
+
+uint16_t traceCount(void){
+    return 0;
+};
+
+uint8_t traceRead(uint16_t i, TRACEEVENT *ev){
+    return 0;
+};
+
+void traceClear(void){
+};
+#endif
@@ -0,0 +1,52 @@
+#ifndef __BASICTRACE_H_
+#define __BASICTRACE_H_
+
+#include <stdint.h>
+
+/* Timestamped events in a RAM ring of CFG_TRACE entries (see
+ * projectconfig.h, 0 leaves the hooks out). traceDump() sends the ring
+ * over USB CDC, tools/trace/trace2json.pl turns that into Chrome
+ * trace-event JSON. A BEGIN/END pair is a slice, a MARK an instant. */
+
+#define TR_WORK    1    /* work_queue_minimal() entry, arg: callback */
+#define TR_LCD     2    /* lcdDisplay() */
+#define TR_SSP     3    /* sspSend() of a block, arg: length */
+#define TR_NRFTX   4    /* nrf_snd_pkt_crc_encr(), arg: size */
+#define TR_NRFRX   5    /* nrf_rcv_pkt_poll() with data, end arg: len */
+#define TR_FREAD   6    /* f_read(), arg: bytes asked, end arg: read */
+#define TR_FWRITE  7    /* f_write(), likewise */
+#define TR_EXEC    8    /* execute_file() */
+#define TR_USER    32   /* up to 63 are free for applications */
+
+#define TR_BEGIN   0x00
+#define TR_END     0x40
+#define TR_MARK    0x80
+
+typedef struct {
+    uint32_t time;          /* getMicros(), lower half */
+    uint8_t id;             /* TR_* | phase */
+    uint8_t pad;
+    uint16_t arg;
+} TRACEEVENT;
+
+/* The dump: TRACE_MAGIC, the number of events, the events oldest first */
+#define TRACE_MAGIC 0x31435254  /* "TRC1" */
+
+#if CFG_TRACE
+#define TRACE_BEGIN(id,arg) traceEvent((id)|TR_BEGIN,(arg))
+#define TRACE_END(id,arg)   traceEvent((id)|TR_END,(arg))
+#define TRACE_MARK(id,arg)  traceEvent((id)|TR_MARK,(arg))
+#else
+#define TRACE_BEGIN(id,arg) do{}while(0)
+#define TRACE_END(id,arg)   do{}while(0)
+#define TRACE_MARK(id,arg)  do{}while(0)
+#endif
+
+void traceEvent(uint8_t id, uint16_t arg);
+void traceEnable(uint8_t on);
+uint16_t traceCount(void);
+uint8_t traceRead(uint16_t i, TRACEEVENT *ev);
+void traceClear(void);
+void traceDump(void);
+
+#endif
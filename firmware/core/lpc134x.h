@@ -1940,9 +1940,13 @@ typedef struct
 #ifdef __arm__
 static inline void __enable_irq()                 { __asm volatile ("cpsie i"); }
 static inline void __disable_irq()                { __asm volatile ("cpsid i"); }
+static inline uint32_t __get_PRIMASK()            { uint32_t result; __asm volatile ("mrs %0, primask" : "=r" (result) ); return(result); }
+static inline void __set_PRIMASK(uint32_t mask)   { __asm volatile ("msr primask, %0" : : "r" (mask) : "memory"); }
 #else
 void __enable_irq();
 void __disable_irq();
+uint32_t __get_PRIMASK();
+void __set_PRIMASK(uint32_t mask);
 #endif
 
 typedef enum IRQn
@@ -3323,6 +3327,12 @@ static inline void NVIC_DisableIRQ(IRQn_t IRQn)
 #define SYSTICK_STCALIB_SKEW_MASK                 (0x40000000)
 #define SYSTICK_STCALIB_NOREF_MASK                (0x80000000)
 
+/*  ICSR (Interrupt Control and State register of the core), the systick
+    interrupt is pending while PENDSTSET is set */
+
+#define SYSTICK_ICSR                              (*(pREG32 (0xE000ED04)))
+#define SYSTICK_ICSR_PENDSTSET                    (0x04000000)
+
 /*##############################################################################
 ## ADC
 ##############################################################################*/
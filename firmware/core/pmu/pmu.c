@@ -170,6 +170,47 @@ void pmuSleep()
   return;
 }
 
+/**************************************************************************/
+/*! 
+    @brief  Sleeps with the systick stopped, for tickless idle.
+
+    CT32B1 counts microseconds and wakes the core after us microseconds
+    unless another interrupt (e.g. a button) comes first.  The systick
+    is restarted afterwards, the caller has to advance its tick counter
+    by the time that passed.  May be called with interrupts disabled,
+    a pending interrupt then ends the sleep but runs only once the
+    caller enables them again.
+
+    @param[in]  us
+                The maximum number of microseconds to sleep.
+
+    @return     The number of microseconds actually slept.
+*/
+/**************************************************************************/
+uint32_t pmuSleepTickless(uint32_t us)
+{
+  uint32_t slept;
+
+  SCB_SYSAHBCLKCTRL |= (SCB_SYSAHBCLKCTRL_CT32B1);
+  TMR_TMR32B1TCR = TMR_TMR32B1TCR_COUNTERENABLE_DISABLED;
+  TMR_TMR32B1PR = CFG_CPU_CCLK/1000000 - 1;
+  TMR_TMR32B1PC = 0;
+  TMR_TMR32B1TC = 0;
+  TMR_TMR32B1MR0 = us;
+  TMR_TMR32B1MCR = TMR_TMR32B1MCR_MR0_INT_ENABLED | TMR_TMR32B1MCR_MR0_STOP_ENABLED;
+  NVIC_EnableIRQ(TIMER_32_1_IRQn);
+
+  SYSTICK_STCTRL &= ~(SYSTICK_STCTRL_ENABLE | SYSTICK_STCTRL_TICKINT);
+  TMR_TMR32B1TCR = TMR_TMR32B1TCR_COUNTERENABLE_ENABLED;
+  pmuSleep();
+  slept = TMR_TMR32B1TC;
+  TMR_TMR32B1TCR = TMR_TMR32B1TCR_COUNTERENABLE_DISABLED;
+
+  // Resume the interrupted tick, getMicros() counts its elapsed part
+  SYSTICK_STCTRL |= (SYSTICK_STCTRL_ENABLE | SYSTICK_STCTRL_TICKINT);
+  return slept;
+}
+
 /**************************************************************************/
 /*! 
     @brief  Turns off select peripherals and puts the device in deep-sleep
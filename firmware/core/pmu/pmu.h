@@ -44,6 +44,7 @@
 void WAKEUP_IRQHandler( void );
 void pmuInit( void );
 void pmuSleep( void );
+uint32_t pmuSleepTickless(uint32_t us);
 void pmuDeepSleep(uint32_t sleepCtrl, uint32_t wakeupSeconds);
 void pmuPowerDown( void );
 
@@ -81,6 +81,18 @@
     #define CFG_USBCDC_INITTIMEOUT      (5000)
     #define CFG_USBCDC_BUFFERSIZE       (256)
 
+/* Events kept by the trace ring (basic/trace.h), 8 bytes each.
+   0 leaves tracing out. */
+#ifndef CFG_TRACE
+    #define CFG_TRACE                   (0)
+#endif
+
+/* Bytes for recently drawn strings (lcd/render.c), 0 leaves the text
+   cache out. */
+#ifndef CFG_TEXTCACHE
+    #define CFG_TEXTCACHE               (384)
+#endif
+
 
 /* you will need these for the UART */
 #if 0
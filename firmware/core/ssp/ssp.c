@@ -68,12 +68,15 @@
 /**************************************************************************/
 #include "ssp.h"
 #include "core/gpio/gpio.h"
+#include "basic/trace.h"
 
 /* Statistics for all interrupts */
 volatile uint32_t interruptRxStat = 0;
 volatile uint32_t interruptOverRunStat = 0;
 volatile uint32_t interruptRxTimeoutStat = 0;
 
+void (* volatile sspBackground)(void) = NULL;
+
 /**************************************************************************/
 /*! 
     @brief SSP0 interrupt handler for SPI communication
@@ -90,6 +93,16 @@ void SSP_IRQHandler (void)
 
   regValue = SSP_SSP0MIS;
 
+  /* Background transfer, it drains the Rx FIFO itself */
+  if ( regValue & SSP_SSP0MIS_TXMIS_HALFEMPTY )
+  {
+    if ( sspBackground )
+      sspBackground();
+    else
+      SSP_SSP0IMSC &= ~SSP_SSP0IMSC_TXIM_MASK;
+    return;
+  }
+
   /* Check for overrun interrupt */
   if ( regValue & SSP_SSP0MIS_RORMIS_FRMRCVD )
   {
@@ -140,6 +153,9 @@ void SSP_IRQHandler (void)
 /**************************************************************************/
 void sspInit (uint8_t portNum, sspClockPolarity_t polarity, sspClockPhase_t phase)
 {
+  /* Don't reset CR0/IMSC under a background transfer */
+  sspWait();
+
   gpioInit();
 
   if (portNum == 0)
@@ -243,6 +259,10 @@ void sspSend (uint8_t portNum, const uint8_t *buf, uint32_t length)
   uint32_t i;
   uint8_t Dummy = Dummy;
 
+  /* single bytes are register accesses, too many to trace */
+  if (length > 1)
+    TRACE_BEGIN(TR_SSP, length);
+
   if (portNum == 0)
   {
     for (i = 0; i < length; i++)
@@ -260,6 +280,8 @@ void sspSend (uint8_t portNum, const uint8_t *buf, uint32_t length)
     }
   }
 
+  if (length > 1)
+    TRACE_END(TR_SSP, length);
   return; 
 }
 
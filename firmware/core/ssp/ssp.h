@@ -77,6 +77,24 @@ typedef enum sspClockPhase_e
 } 
 sspClockPhase_t;
 
+/* A transfer running in the background (see lcdFlip()): while set, the
+   TX interrupt calls it to refill the FIFO, and it clears itself when
+   done. Drivers select their chip with sspSelect(), which waits for it
+   and keeps an interrupt from starting one before the chip select is
+   low (see lcdGrayStart()). */
+extern void (* volatile sspBackground)(void);
+#define sspWait()               do {while (sspBackground);} while (0)
+#define sspSelect(cs)           do { \
+                                  for (;;) { \
+                                    sspWait(); \
+                                    __disable_irq(); \
+                                    if (!sspBackground) break; \
+                                    __enable_irq(); \
+                                  } \
+                                  gpioSetValue(cs, 0); \
+                                  __enable_irq(); \
+                                } while (0)
+
 extern void SSP_IRQHandler (void);
 void sspInit (uint8_t portNum, sspClockPolarity_t polarity, sspClockPhase_t phase);
 void sspSend (uint8_t portNum, const uint8_t *buf, uint32_t length);
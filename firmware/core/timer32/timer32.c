@@ -152,6 +152,8 @@ void (*callback)(void);
 	@brief Interrupt handler for 32-bit timer 1
 */
 /**************************************************************************/
+void (*timer32Callback1)(void);
+
 void TIMER32_1_IRQHandler(void)
 {  
   /* Clear the interrupt flag */
@@ -160,6 +162,8 @@ void TIMER32_1_IRQHandler(void)
   /* If you wish to perform some action after each timer 'tick' (such as 
      incrementing a counter variable) you can do so here */
   timer32_1_counter++;
+  if (timer32Callback1)
+    timer32Callback1();
 
   return;
 }
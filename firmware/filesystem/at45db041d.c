@@ -30,7 +30,7 @@
 
 #define MAX_PAGE          (2048)
 
-#define CS_LOW()    gpioSetValue(RB_SPI_CS_DF, 0)
+#define CS_LOW()    sspSelect(RB_SPI_CS_DF)
 #define CS_HIGH()   gpioSetValue(RB_SPI_CS_DF, 1)
 
 static volatile DSTATUS status = STA_NOINIT;
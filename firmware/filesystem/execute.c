@@ -4,89 +4,361 @@
 #include "basic/basic.h"
 
 #include "lcd/print.h"
+#include "lcd/display.h"
 
 #include "usb/usbmsc.h"
 
 #include "filesystem/ff.h"
 #include "filesystem/select.h"
+#include "filesystem/execute.h"
 
 #include "basic/xxtea.h"
 
 #include "SECRETS"
 
 //extern void * sram_top;
+extern const void * TheTable[];
+extern const uint32_t TheTableHash[];
+extern const uint8_t TheTableHashes;
 
 /**************************************************************************/
 
-uint8_t execute_file (const char * fname){
-    FRESULT res;
-    FIL file;
+#define C0D_BUFSIZE 32
+
+typedef struct {
+    FIL *file;              /* NULL: container is in memory already */
+    const uint8_t *p;
+    const uint8_t *end;
+    uint8_t buf[C0D_BUFSIZE];
+} C0DIN;
+
+static int c0d_getc(C0DIN *in){
     UINT readbytes;
-    void (*dst)(void);
 
-    /* XXX: why doesn't this work? sram_top contains garbage?
-    dst=(void (*)(void)) (sram_top); 
-    lcdPrint("T:"); lcdPrintIntHex(dst); lcdNl();
-    */
-    dst=(void (*)(void)) (0x10002000 - RAMCODE);
+    if(in->p == in->end){
+        if(!in->file || f_read(in->file, in->buf, C0D_BUFSIZE, &readbytes)
+                || !readbytes)
+            return -1;
+        in->p=in->buf;
+        in->end=in->buf+readbytes;
+    };
+    return *in->p++;
+}
 
-    res=f_open(&file, fname, FA_OPEN_EXISTING|FA_READ);
+/* Copy up to len bytes, returns the number of bytes copied.
+ * Large runs are read from the file directly into place. */
+static uint16_t c0d_read(C0DIN *in, uint8_t *out, uint16_t len){
+    uint16_t done=0, n;
+    UINT readbytes;
+    int c;
 
-    //lcdPrint("open: ");
-    //lcdPrintln(f_get_rc_string(res));
-    //lcdRefresh();
-    if(res){
-        return -1;
+    while(done<len){
+        n=in->end - in->p;
+        if(n){
+            if(n>len-done)
+                n=len-done;
+            memmove(out+done, in->p, n);
+            in->p+=n;
+            done+=n;
+        }else if(in->file && len-done >= C0D_BUFSIZE){
+            if(f_read(in->file, out+done, len-done, &readbytes) || !readbytes)
+                break;
+            done+=readbytes;
+        }else{
+            if((c=c0d_getc(in))<0)
+                break;
+            out[done++]=c;
+        };
     };
-    
-    res = f_read(&file, (char *)dst, RAMCODE, &readbytes);
-    //lcdPrint("read: ");
-    //lcdPrintln(f_get_rc_string(res));
-    //lcdRefresh();
-    if(res){
-        return -1;
+    return done;
+}
+
+static int c0d_len(C0DIN *in, int len){
+    int c;
+
+    if(len==15)
+        do{
+            if((c=c0d_getc(in))<0)
+                return -1;
+            len+=c;
+        }while(c==255);
+    return len;
+}
+
+/* Sequences: token (literal count<<4 | match length-4), literals,
+ * 16 bit match offset. The last sequence ends with the image. */
+static int c0d_unpack(C0DIN *in, uint8_t *dst, uint16_t size){
+    uint8_t *out=dst, *end=dst+size, *ref;
+    int token, len, lo, hi;
+
+    while(1){
+        if((token=c0d_getc(in))<0)
+            return -1;
+        len=c0d_len(in, token>>4);
+        if(len<0 || len>end-out || c0d_read(in, out, len)!=len)
+            return -1;
+        out+=len;
+        if(out==end)
+            return 0;
+
+        if((lo=c0d_getc(in))<0 || (hi=c0d_getc(in))<0)
+            return -1;
+        ref=out-(lo|hi<<8);
+        len=c0d_len(in, token&0xf);
+        if(len<0 || ref<dst || ref==out || len+4>end-out)
+            return -1;
+        len+=4;
+        while(len--)
+            *out++=*ref++;
+    };
+}
+
+static int c0d_relocate(C0DIN *in, uint8_t *dst, const C0DHDR *hdr){
+    uint32_t delta=(uint32_t)dst - hdr->base;
+    uint16_t i, off;
+
+    for(i=0;i<hdr->nrelocs;i++){
+        if(c0d_read(in, (uint8_t*)&off, sizeof(off))!=sizeof(off)
+                || off&3 || off+4>hdr->size)
+            return -1;
+        *(uint32_t*)(dst+off)+=delta;
+    };
+    return 0;
+}
+
+/* Turn calls through the import placeholders into direct calls */
+static int c0d_bind(C0DIN *in, uint8_t *dst, const C0DHDR *hdr){
+    uint16_t i, imp[2];
+
+    for(i=0;i<hdr->nimports;i++){
+        if(c0d_read(in, (uint8_t*)imp, sizeof(imp))!=sizeof(imp)
+                || imp[0]&3 || imp[0]+4>hdr->size)
+            return -1;
+        *(uint32_t*)(dst+imp[0])=(uint32_t)TheTable[imp[1]];
     };
+    return 0;
+}
+
+/* Whether the exports up to the last import of the l0dable are the
+ * same as ours, see mktable.pl */
+static uint8_t c0d_table(uint32_t hash){
+    uint8_t i;
+
+    for(i=0;i<TheTableHashes;i++)
+        if(TheTableHash[i]==hash)
+            return 1;
+    return 0;
+}
+
+static uint8_t execute_error(const char *msg){
+    lcdClear();
+    lcdPrint(msg);
+    lcdRefresh();
+    getInputWait();
+    getInputWaitRelease();
+    return -1;
+}
+
+/* Modification time and date of the file that was just opened,
+ * taken from the directory entry still in the window (no f_stat here). */
+static uint32_t execute_stamp(FIL *file){
+    const uint8_t *d=file->dir_ptr+22;
+
+    return d[0] | d[1]<<8 | d[2]<<16 | (uint32_t)d[3]<<24;
+}
+
+/* Returns NULL on success, else a message for execute_error(),
+ * empty for errors that are not worth a message. */
+static const char *execute_load(FIL *file, uint8_t *dst, uint16_t max){
+    FRESULT res;
+    C0DIN in;
+    C0DHDR hdr;
+    uint16_t len;
+
+    in.file=file;
+    in.p=in.end=in.buf;
+
 #ifdef ENCRYPT_L0DABLE
+    /* The whole file is needed for the MAC: read it to the end of the
+     * window and unpack from there, mkc0d.pl makes sure that the output
+     * never overtakes the input. */
+    uint8_t *src;
+    UINT readbytes;
     uint32_t *data;
-    uint32_t len;
     uint32_t mac[4];
-    data = (uint32_t*)dst;
-    len = readbytes/4;
 
-    if( readbytes & 0xF || readbytes <= 0x10){
-        lcdClear();
-        lcdPrint("!size");
-        lcdRefresh();
-        getInputWait();
-        getInputWaitRelease();
-        return -1;
-    }
+    if( file->fsize & 0xF || file->fsize <= 0x10 || file->fsize > max)
+        return "!size";
 
-    xxtea_cbcmac(mac, (uint32_t*)dst, len-4, l0dable_sign_key);
+    src = dst + max - file->fsize;
+    res = f_read(file, src, file->fsize, &readbytes);
+    if(res || readbytes != file->fsize)
+        return "";
+
+    data = (uint32_t*)src;
+    len = readbytes/4;
+    xxtea_cbcmac(mac, data, len-4, l0dable_sign_key);
     if( data[len-4] != mac[0] || data[len-3] != mac[1]
         || data[len-2] != mac[2] || data[len-1] != mac[3] ){
-        lcdClear();
-        lcdPrint("!mac");
         //lcdPrintIntHex(mac[0]); lcdNl();
         //lcdPrintIntHex(mac[1]); lcdNl();
         //lcdPrintIntHex(mac[2]); lcdNl();
         //lcdPrintIntHex(mac[3]); lcdNl();
-        lcdRefresh();
-        getInputWait();
-        getInputWaitRelease();
-        return -1;
+        return "!mac";
     }
-    data = (uint32_t*)dst;
-    len = readbytes/4;
     xxtea_decode_words(data, len-4, l0dable_crypt_key);
+
+    in.file=NULL;
+    in.p=src;
+    in.end=src+readbytes-16;
 #endif
 
+    len=c0d_read(&in, (uint8_t*)&hdr, sizeof(hdr));
+    if(len==sizeof(hdr) && hdr.magic==C0D_MAGIC){
+        if(hdr.nimports && !c0d_table(hdr.table))
+            return "!table";
+        if(hdr.size>max)
+            res=1;
+        else if(hdr.packed)
+            res=c0d_unpack(&in, dst, hdr.size);
+        else
+            res=(c0d_read(&in, dst, hdr.size)!=hdr.size);
+        if(res || c0d_relocate(&in, dst, &hdr) || c0d_bind(&in, dst, &hdr))
+            return "!c0d";
+    }else{
+        memmove(dst, &hdr, len);
+        c0d_read(&in, dst+len, max-len);
+    };
+    return NULL;
+}
+
+/* Load a l0dable to dst (at most max bytes) without running it.
+ * Raw images are not relocatable and only work at their link address. */
+uint8_t executeLoad (const char * fname, uint8_t *dst, uint16_t max){
+    FRESULT res;
+    FIL file;
+    const char *err;
+
+    res=f_open(&file, fname, FA_OPEN_EXISTING|FA_READ);
+
+    //lcdPrint("open: ");
+    //lcdPrintln(f_get_rc_string(res));
+    //lcdRefresh();
+    if(res){
+        return -1;
+    };
+    err=execute_load(&file, dst, max);
+    f_close(&file);
+    if(!err)
+        return 0;
+    if(*err)
+        execute_error(err);
+    return -1;
+};
+
+/**************************************************************************/
+
+/* The file highlighted in executeSelect() is loaded into the RAMCODE
+ * area from the work queue while the user looks at the menu.
+ * execute_file() uses that image if the file did not change since. */
+
+#define PF_NONE    0
+#define PF_PENDING 1
+#define PF_VALID   2
+
+static struct {
+    char name[15];
+    uint32_t fsize;
+    uint32_t stamp;
+    uint8_t state;
+    uint8_t queued;
+} prefetch;
+
+#define RAMCODE_START ((uint8_t*)(0x10002000 - RAMCODE))
+
+static void execute_prefetch_job(void){
+    FIL file;
+
+    prefetch.queued=0;
+    if(prefetch.state!=PF_PENDING)
+        return;
+    prefetch.state=PF_NONE;
+    if(f_open(&file, prefetch.name, FA_OPEN_EXISTING|FA_READ))
+        return;
+    prefetch.fsize=file.fsize;
+    prefetch.stamp=execute_stamp(&file);
+    if(!execute_load(&file, RAMCODE_START, RAMCODE))
+        prefetch.state=PF_VALID;
+    f_close(&file);
+}
+
+/* Request a background load of fname, NULL cancels and drops a loaded
+ * image (RAMCODE may be reused before the next execute_file()). A newer
+ * request replaces one that has not run yet. */
+void executePrefetch(const char * fname){
+    if(!fname){
+        prefetch.state=PF_NONE;
+        return;
+    };
+    if(prefetch.state!=PF_NONE && !strcmp(prefetch.name, fname))
+        return;
+    strcpy(prefetch.name, fname);
+    prefetch.state=PF_PENDING;
+    if(!prefetch.queued && !push_queue_prio(&execute_prefetch_job, QP_STORAGE))
+        prefetch.queued=1;
+}
+
+static uint8_t execute_prefetched(const char * fname){
+    FIL file;
+    uint8_t ok;
+
+    if(prefetch.state!=PF_VALID || strcmp(prefetch.name, fname))
+        return 0;
+    if(f_open(&file, fname, FA_OPEN_EXISTING|FA_READ))
+        return 0;
+    ok=(file.fsize==prefetch.fsize && execute_stamp(&file)==prefetch.stamp);
+    f_close(&file);
+    return ok;
+}
+
+uint8_t execute_file (const char * fname){
+    void (*dst)(void);
+
+    /* XXX: why doesn't this work? sram_top contains garbage?
+    dst=(void (*)(void)) (sram_top); 
+    lcdPrint("T:"); lcdPrintIntHex(dst); lcdNl();
+    */
+    dst=(void (*)(void)) RAMCODE_START;
+
+    TRACE_BEGIN(TR_EXEC,0);
+    if(!execute_prefetched(fname)){
+        prefetch.state=PF_NONE;
+        if(executeLoad(fname, (uint8_t*)dst, RAMCODE)){
+            TRACE_END(TR_EXEC,-1);
+            return -1;
+        };
+    };
+    /* the image modifies its own data while running */
+    prefetch.state=PF_NONE;
+
     dst=(void (*)(void)) ((uint32_t)(dst) | 1); // Enable Thumb mode!
     dst();
+    /* the l0dable may have left a back buffer in its own RAM */
+    lcdDoubleBuffer(NULL);
+    TRACE_END(TR_EXEC,0);
     return 0;
 
 };
 
+static void execute_highlight(const char *name){
+    char filename[15];
+
+    filename[0]='0';
+    filename[1]=':';
+    strcpy(filename+2, name);
+    executePrefetch(filename);
+}
+
 /**************************************************************************/
 
 void executeSelect(const char *ext){
@@ -95,7 +367,9 @@ void executeSelect(const char *ext){
     filename[1]=':';
     filename[2]=0;
 
-    if( selectFile(filename+2,ext) == 0)
+    if( selectFileHighlight(filename+2,ext,&execute_highlight) == 0)
         execute_file(filename);
+    else
+        executePrefetch(NULL);
 };
 
@@ -1,7 +1,29 @@
 #ifndef _EXECUTE_H_
 #define _EXECUTE_H_
 
+#include <stdint.h>
+
+/* .c0d container as written by l0dable/mkc0d.pl (little endian):
+ * header, image body (LZ4-style sequences, stored if packed==0),
+ * nrelocs uint16_t offsets of words holding absolute addresses into the
+ * image, then nimports pairs of uint16_t (word offset, TheTable index)
+ * for firmware functions that are bound when loading.
+ * Files without the magic are loaded as raw images. */
+#define C0D_MAGIC 0x02643063 /* "c0d\2" */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t base;      /* address the image was linked for */
+    uint32_t table;     /* hash of the exports up to the last import */
+    uint16_t size;      /* image size after unpacking */
+    uint16_t packed;    /* size of the packed body, 0: stored */
+    uint16_t nrelocs;
+    uint16_t nimports;
+} C0DHDR;
+
+uint8_t executeLoad (const char * fname, uint8_t *dst, uint16_t max);
 uint8_t execute_file (const char * fname);
+void executePrefetch(const char * fname);
 void executeSelect(const char *ext);
 
 #endif
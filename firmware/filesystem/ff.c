@@ -2365,7 +2365,7 @@ FRESULT f_open (
 /* Read File                                                             */
 /*-----------------------------------------------------------------------*/
 
-FRESULT f_read (
+static FRESULT ff_read (
 	FIL *fp, 		/* Pointer to the file object */
 	void *buff,		/* Pointer to data buffer */
 	UINT btr,		/* Number of bytes to read */
@@ -2458,6 +2458,17 @@ FRESULT f_read (
 	LEAVE_FF(fp->fs, FR_OK);
 }
 
+/* The trace hooks, FatFs returns from all over the place */
+FRESULT f_read (FIL *fp, void *buff, UINT btr, UINT *br)
+{
+	FRESULT res;
+
+	TRACE_BEGIN(TR_FREAD, btr);
+	res = ff_read(fp, buff, btr, br);
+	TRACE_END(TR_FREAD, *br);
+	return res;
+}
+
 
 
 
@@ -2466,7 +2477,7 @@ FRESULT f_read (
 /* Write File                                                            */
 /*-----------------------------------------------------------------------*/
 
-FRESULT f_write (
+static FRESULT ff_write (
 	FIL *fp,			/* Pointer to the file object */
 	const void *buff,	/* Pointer to the data to be written */
 	UINT btw,			/* Number of bytes to write */
@@ -2578,6 +2589,16 @@ FRESULT f_write (
 	LEAVE_FF(fp->fs, FR_OK);
 }
 
+FRESULT f_write (FIL *fp, const void *buff, UINT btw, UINT *bw)
+{
+	FRESULT res;
+
+	TRACE_BEGIN(TR_FWRITE, btw);
+	res = ff_write(fp, buff, btw, bw);
+	TRACE_END(TR_FWRITE, *bw);
+	return res;
+}
+
 
 
 
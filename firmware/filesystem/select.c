@@ -45,7 +45,10 @@ int getFiles(char files[][FLEN], uint8_t count, uint16_t skip, const char *ext)
 }
 
 #define PERPAGE 7
-int selectFile(char *filename, const char *extension)
+/* highlight (if set) is called with the file under the cursor
+ * whenever the selection is shown */
+int selectFileHighlight(char *filename, const char *extension,
+        void (*highlight)(const char *))
 {
     int skip = 0;
     char key;
@@ -88,6 +91,8 @@ int selectFile(char *filename, const char *extension)
                 files[i][dot]='.';
         }
         lcdRefresh();
+        if(highlight)
+            highlight(files[selected]);
         key=getInputWait();
         getInputWaitRelease();
         switch(key){
@@ -118,3 +123,8 @@ int selectFile(char *filename, const char *extension)
         }
     }
 }
+
+int selectFile(char *filename, const char *extension)
+{
+    return selectFileHighlight(filename, extension, NULL);
+}
@@ -6,5 +6,7 @@
 
 int getFiles(char files[][FLEN], uint8_t count, uint16_t skip, const char *ext);
 int selectFile(char *filename, const char *extension);
+int selectFileHighlight(char *filename, const char *extension,
+        void (*highlight)(const char *));
 
 #endif
@@ -19,6 +19,33 @@ MPKT meshbuffer[MESHBUFSIZE];
 
 struct NRF_CFG oldconfig;
 
+/* [T]ime packets carry the milliseconds of MO_TIME plus one (0 from
+ * older firmware) in body[0..1] and the sender's rate clock in
+ * body[6..9]. Their reception is only seen on the next poll, after
+ * TS_LATENCY on average. */
+#define TS_LATENCY 5000
+
+static void mesh_stamp(uint8_t *pkt){
+    int64_t now=getMicrosWall();
+    uint16_t ms=now%1000000/1000+1;
+
+    MO_TIME_set(pkt,now/1000000);
+    MO_BODY(pkt)[0]=ms>>8;
+    MO_BODY(pkt)[1]=ms;
+    uint32touint8p(getMicrosRate(),MO_BODY(pkt)+6);
+};
+
+static uint8_t mesh_timesync(uint8_t *pkt, uint64_t rx){
+    uint16_t ms=MO_BODY(pkt)[0]<<8|MO_BODY(pkt)[1];
+    int64_t remote=(int64_t)MO_TIME(pkt)*1000000;
+
+    if(ms<1 || ms>1000)
+        return timeSync(remote+500000, 0, 0, rx);
+    remote+=(ms-1)*1000+500+TS_LATENCY;
+    return timeSync(remote, uint8ptouint32(MO_BODY(pkt)+6),
+            uint8ptouint32(pkt+26), rx);
+};
+
 static int mesh_gt(char curgen, char newgen){
     unsigned char dif=curgen-newgen;
     if(curgen==0)
@@ -32,7 +59,7 @@ void initMesh(void){
     };
     memset(meshbuffer[0].pkt,0,MESHPKTSIZE);
     meshbuffer[0].pkt[0]='T';
-    MO_TIME_set(meshbuffer[0].pkt,getSeconds());
+    mesh_stamp(meshbuffer[0].pkt);
     meshbuffer[0].flags=MF_USED;
 };
 
@@ -146,8 +173,7 @@ void mesh_sendloop(void){
     nrf_set_channel(MESH_CHANNEL);
     nrf_set_tx_mac(strlen(MESH_MAC),(uint8_t*)MESH_MAC);
 
-    // Update [T]ime packet
-    MO_TIME_set(meshbuffer[0].pkt,getSeconds());
+    // Update [T]ime packet, its time is set when it is sent
     MO_GEN_set(meshbuffer[0].pkt,meshgen);
     if(GLOBAL(privacy)==0)
         uint32touint8p(GetUUID32(),meshbuffer[0].pkt+26);
@@ -168,6 +194,8 @@ void mesh_sendloop(void){
             };
         };
         ctr++;
+        if(i==0)
+            mesh_stamp(meshbuffer[0].pkt);
         memcpy(buf,meshbuffer[i].pkt,MESHPKTSIZE);
         status=nrf_snd_pkt_crc_encr(MESHPKTSIZE,buf,NULL);
         //Check status? But what would we do...
@@ -176,16 +204,19 @@ void mesh_sendloop(void){
     nrf_config_set(&oldconfig);
 };
 
+static void mesh_listen(void){
+    nrf_set_channel(MESH_CHANNEL);
+    nrf_set_rx_mac(0,MESHPKTSIZE,strlen(MESH_MAC),(uint8_t*)MESH_MAC);
+    nrf_rcv_pkt_start();
+};
+
 void mesh_recvqloop_setup(void){
 
     nrf_config_get(&oldconfig);
 
-    nrf_set_channel(MESH_CHANNEL);
-    nrf_set_rx_mac(0,MESHPKTSIZE,strlen(MESH_MAC),(uint8_t*)MESH_MAC);
-
     mesh_cleanup();
 
-    nrf_rcv_pkt_start();
+    mesh_listen();
 };
 
 static inline uint32_t popcount(uint32_t *buf, uint8_t n){
@@ -205,8 +236,10 @@ static inline uint32_t popcount(uint32_t *buf, uint8_t n){
 uint8_t mesh_recvqloop_work(void){
     __attribute__ ((aligned (4))) uint8_t buf[32];
     unsigned int len;
+    uint64_t rx;
 
         len=nrf_rcv_pkt_poll_dec(sizeof(buf),buf,NULL);
+        rx=getMicros();
 
         // Receive
         if(len<=0){
@@ -225,6 +258,7 @@ uint8_t mesh_recvqloop_work(void){
         if(MO_TYPE(buf)=='T'){
             if(mesh_gt(meshgen,MO_GEN(buf))){
                 _timet=0;
+                timeReset();
                 meshincctr=0;
                 meshnice=MO_BODY(buf)[4];
                 meshgen=MO_GEN(buf);
@@ -236,13 +270,10 @@ uint8_t mesh_recvqloop_work(void){
             return 0;
         };
 
-        // Set new time iff newer
+        // Follow the time of our peers
         if(MO_TYPE(buf)=='T'){
-            time_t toff=MO_TIME(buf)-((getTimer()+(600/SYSTICKSPEED))/(1000/SYSTICKSPEED));
-            if (toff>_timet){ // Do not live in the past.
-                _timet = toff;
+            if(mesh_timesync(buf, rx))
                 meshincctr++;
-            };
             return 1;
         };
 
@@ -326,43 +357,62 @@ void mesh_recvloop(void){
     mesh_recvqloop_end();
 };
 
-uint8_t mesh_recvloop_plus(uint8_t state){
-    static int recvend=0;
-    static int pktctr=0;
+/* While the coroutine waits, other QP_RADIO jobs (mesh_sendloop(),
+ * beacons) use the radio and save and restore configs of their own, so
+ * it keeps the config to go back to to itself. */
+static struct {
+    CORO co;
+    struct NRF_CFG config;
+    int recvend;
+    int pktctr;
+} meshrecv;
+
+/* Listen again if someone else had the radio: sending leaves it out of
+ * RX mode. Otherwise keep what is in the RX FIFO. */
+static void mesh_relisten(void){
+    if(nrf_read_reg(R_CONFIG)&R_CONFIG_PRIM_RX && gpioGetValue(RB_NRF_CE)
+            && nrf_read_reg(R_RF_CH)==MESH_CHANNEL)
+        return;
+    mesh_listen();
+};
 
-    if (state==0){
-            recvend=M_RECVTIM/SYSTICKSPEED+getTimer();
-            pktctr=0;
+static uint8_t mesh_recv_co(CORO *c){
+    CO_BEGIN(c);
+    meshrecv.recvend=M_RECVTIM/SYSTICKSPEED+getTimer();
+    meshrecv.pktctr=0;
 
-            mesh_recvqloop_setup();
-            state=1;
-    };
-    if(state==1){
-            if( mesh_recvqloop_work() ){
-                pktctr++;
-            }else{
-                delayms_power(10);
-            };
-            if(getTimer()>recvend || pktctr>MESHBUFSIZE)
-                state=QS_END;
+    nrf_config_get(&meshrecv.config);
+    mesh_cleanup();
+    mesh_listen();
+    while(getTimer()<=meshrecv.recvend && meshrecv.pktctr<=MESHBUFSIZE){
+        if( mesh_recvqloop_work() ){
+            meshrecv.pktctr++;
+        }else{
+            CO_AWAIT(c, EV_RADIO, 10);
+            mesh_relisten();
+        };
     };
-    return state;
+    nrf_rcv_pkt_end();
+    nrf_config_set(&meshrecv.config);
+    CO_END(c);
 };
 
-void mesh_systick(void){
-    static int rcvctr=0;
-    static int sendctr=0;
+static void mesh_recvstart(void){
+    coroStart(&meshrecv.co, &mesh_recv_co, QP_RADIO);
+};
 
-    if(rcvctr--<0){
-        push_queue_plus(&mesh_recvloop_plus);
-        rcvctr=M_RECVINT/SYSTICKSPEED/2;
-        rcvctr+=getRandom()%(rcvctr*2);
-    };
+static QTIMER recvtimer={.prio=QP_RADIO, .type=QT_NORMAL,
+    .u.callback=&mesh_recvstart};
+static QTIMER sendtimer={.prio=QP_RADIO, .type=QT_NORMAL,
+    .u.callback=&mesh_sendloop};
 
-    if(sendctr--<0){
-        push_queue(&mesh_sendloop);
-        sendctr=M_SENDINT/SYSTICKSPEED/2;
-        sendctr+=getRandom()%(sendctr*2);
-    };
+/* Called from the tick: rearm the receive and send timers with a random
+ * interval of 0.5 to 1.5 times the nominal one once they have fired. */
+void mesh_systick(void){
+    if(!recvtimer.armed)
+        timerStart(&recvtimer, M_RECVINT/2+getRandom()%M_RECVINT);
+
+    if(!sendtimer.armed)
+        timerStart(&sendtimer, M_SENDINT/2+getRandom()%M_SENDINT);
 };
 
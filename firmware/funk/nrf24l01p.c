@@ -2,6 +2,7 @@
 #include <nrf24l01p.h>
 #include "core/ssp/ssp.h"
 #include "basic/xxtea.h"
+#include "basic/random.h"
 
 #define DEFAULT_SPEED R_RF_SETUP_DR_2M
 
@@ -18,7 +19,7 @@ inline void rcv_spi(uint8_t *dat) {
     sspReceive(0, dat, 1);
 }
 
-#define CS_LOW()    gpioSetValue(RB_SPI_NRF_CS, 0)
+#define CS_LOW()    sspSelect(RB_SPI_NRF_CS)
 #define CS_HIGH()   gpioSetValue(RB_SPI_NRF_CS, 1)
 #define CE_LOW()    gpioSetValue(RB_NRF_CE, 0)
 #define CE_HIGH()   gpioSetValue(RB_NRF_CE, 1)
@@ -108,6 +109,11 @@ void nrf_rcv_pkt_start(void){
     CE_HIGH();
 };
 
+/* Event source for coroutines waiting on EV_RADIO */
+uint8_t nrf_rcv_pkt_avail(void){
+    return (nrf_cmd_status(C_NOP) & R_STATUS_RX_P_NO) != R_STATUS_RX_FIFO_EMPTY;
+};
+
 int nrf_rcv_pkt_poll(int maxsize, uint8_t * pkt){
     uint8_t len;
     uint8_t status=0;
@@ -126,19 +132,26 @@ int nrf_rcv_pkt_poll(int maxsize, uint8_t * pkt){
         return 0;
     };
 
+    TRACE_BEGIN(TR_NRFRX,0);
     nrf_read_long(C_R_RX_PL_WID,1,&len);
 
     nrf_write_reg(R_STATUS,R_STATUS_RX_DR);
     if(len>32 || len==0){
+        TRACE_END(TR_NRFRX,-2);
         return -2; // no packet error
     };
 
     if(len>maxsize){
+        TRACE_END(TR_NRFRX,-1);
         return -1; // packet too large
     };
 
     nrf_read_pkt(len,pkt);
 
+    /* arrival time within the current tick is radio timing jitter */
+    randomAddEntropy(SYSTICK_STCURR ^ (len<<24) ^ pkt[0]);
+
+    TRACE_END(TR_NRFRX,len);
     return len;
 };
 
@@ -240,6 +253,7 @@ char nrf_snd_pkt_crc_encr(int size, uint8_t * pkt, uint32_t const key[4]){
     if(size > MAX_PKT)
         size=MAX_PKT;
 
+    TRACE_BEGIN(TR_NRFTX,size);
     nrf_write_reg(R_CONFIG,
             R_CONFIG_PWR_UP|  // Power on
             R_CONFIG_EN_CRC   // CRC on, single byte
@@ -261,6 +275,7 @@ char nrf_snd_pkt_crc_encr(int size, uint8_t * pkt, uint32_t const key[4]){
     delayms(1); // Send it.  (only needs >10ys, i think)
     CE_LOW();
 
+    TRACE_END(TR_NRFTX,size);
     return nrf_cmd_status(C_NOP);
 };
 
@@ -395,6 +410,8 @@ void nrf_init() {
 
     // Clear MAX_RT, just in case.
     nrf_write_reg(R_STATUS,R_STATUS_MAX_RT);
+
+    coroSource(EV_RADIO, &nrf_rcv_pkt_avail);
 };
 
 void nrf_off() {
@@ -160,6 +160,7 @@ void nrf_set_strength(unsigned char strength);
 
 // new receive IF
 void nrf_rcv_pkt_start(void);
+uint8_t nrf_rcv_pkt_avail(void);
 int nrf_rcv_pkt_poll(int maxsize, uint8_t * pkt);
 int nrf_rcv_pkt_poll_dec(int maxsize, uint8_t * pkt, uint32_t const key[4]);
 
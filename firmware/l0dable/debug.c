@@ -8,6 +8,8 @@
 #include "lcd/print.h"
 
 #include "usb/usbmsc.h"
+#include "usbcdc/util.h"
+#include "usbcdc/profile.h"
 
 #include "core/iap/iap.h"
 
@@ -27,6 +29,10 @@ void uptime(void);
 void uuid(void);
 void lcdrtest(void);
 void release(void);
+void profstart(void);
+void profstop(void);
+void raminfo(void);
+void tracedump(void);
 
 static const struct MENU submenu_debug={ "debug", {
 	{ "ChkBattery", &ChkBattery},
@@ -39,6 +45,10 @@ static const struct MENU submenu_debug={ "debug", {
 	{ "Uptime", &uptime},
 	{ "Uuid", &uuid},
 	{ "Release", &release},
+	{ "RamInfo", &raminfo},
+	{ "TraceDump", &tracedump},
+	{ "ProfStart", &profstart},
+	{ "ProfStop", &profstop},
 	{NULL,NULL}
 }};
 
@@ -141,7 +151,7 @@ void Qstatus(void) {
     lcdClear();
     dx=DoString(0,dy+16,"Qdepth:");
     while ((getInputRaw())!=BTN_ENTER){
-        DoInt(dx,dy+16,(the_queue.qend-the_queue.qstart+MAXQENTRIES)%MAXQENTRIES);
+        DoInt(dx,dy+16,the_queue.depth);
         lcdDisplay();
         if(getInputRaw()!=BTN_NONE)
             work_queue();
@@ -341,3 +351,58 @@ void release(){
     lcdRefresh();
     while(!getInputRaw())work_queue();
 };
+
+/* Sample at 1kHz until ProfStop, read the CDC stream with
+ * tools/profile/prof.pl */
+void profstart(){
+    usbCDCInit();
+    lcdPrintln("Waiting for USB");
+    lcdRefresh();
+    delayms_queue(2000);
+    profStart(1000);
+    lcdPrintln("Profiling.");
+    lcdRefresh();
+    while(!getInputRaw())work_queue();
+};
+
+void profstop(){
+    profStop();
+    lcdPrintln("Stopped.");
+    lcdRefresh();
+    while(!getInputRaw())work_queue();
+};
+
+static void ram_line(const char *name, uint32_t val){
+    lcdPrint(name);
+    lcdPrintln(IntToStr(val,5,0));
+    puts(name);
+    puts(IntToStr(val,5,0));
+    puts("\r\n");
+};
+
+/* Stack high-water mark since boot, also sent over CDC when connected.
+ * The per-module split is in firmware.map, see tools/ram/ramuse.pl */
+void raminfo(){
+    lcdClear();
+    lcdPrintln("RAM bytes:");
+    ram_line("static ",ramStatic());
+    ram_line("stack  ",stackSize());
+    ram_line("used   ",stackUsed());
+    ram_line("free   ",stackSize()-stackUsed());
+    ram_line("l0dable",RAMCODE);
+    lcdRefresh();
+    while(!getInputRaw())work_queue();
+};
+
+/* Send the trace ring (CFG_TRACE events) over CDC, convert it with
+ * tools/trace/trace2json.pl */
+void tracedump(){
+    usbCDCInit();
+    lcdPrintln("Waiting for USB");
+    lcdRefresh();
+    delayms_queue(2000);
+    traceDump();
+    lcdPrintln("Done.");
+    lcdRefresh();
+    while(!getInputRaw())work_queue();
+};
@@ -0,0 +1,213 @@
+#!/usr/bin/perl
+#
+# vim:set ts=4 sw=4:
+#
+# Pack a l0dable into the .c0d container read by executeLoad()
+# (see filesystem/execute.h): header, compressed image, relocations.
+#
+# Usage: mkc0d.pl [-r ramcode] [-e EXPORTS] file.elf file.bin file.c0d
+#
+# The .elf has to be linked with --emit-relocs, every R_ARM_ABS32 that
+# points into the image ends up in the relocation table. Words holding
+# an imports.ld placeholder (see mktable.pl) go into the import table.
+
+use strict;
+use Getopt::Std;
+
+my %opt;
+getopts("r:e:",\%opt) && @ARGV==3
+    || die "Usage: $0 [-r ramcode] [-e EXPORTS] elf bin c0d\n";
+my ($elffile,$binfile,$outfile)=@ARGV;
+my $ramcode=$opt{r}||2560;
+my $exports=$opt{e}||"EXPORTS";
+
+my $MAGIC=0x02643063;
+my $HDRSIZE=20;
+my $IMPORT=0xf0000000;
+my $SHT_REL=9;
+my $SHF_ALLOC=2;
+my $R_ARM_ABS32=2;
+my $R_ARM_TARGET1=38;
+my %unsupported=(43=>"MOVW_ABS_NC",44=>"MOVT_ABS",47=>"THM_MOVW_ABS_NC",48=>"THM_MOVT_ABS");
+
+sub slurp {
+    my $file=shift;
+    local $/;
+    open(my $fh,"<",$file) || die "$file: $!";
+    binmode($fh);
+    my $data=<$fh>;
+    close($fh);
+    return $data;
+}
+
+my $elf=slurp($elffile);
+my $bin=slurp($binfile);
+my $size=length($bin);
+
+die "$elffile: not a 32 bit little endian ELF\n"
+    unless substr($elf,0,6) eq "\x7fELF\x01\x01";
+die "$binfile: $size bytes do not fit into $ramcode\n" if $size>$ramcode;
+
+### Sections
+
+my ($shoff)=unpack("V",substr($elf,0x20,4));
+my ($shentsize,$shnum)=unpack("vv",substr($elf,0x2e,4));
+my @sh;
+for my $i (0..$shnum-1){
+    my %s;
+    @s{qw(name type flags addr offset size link info)}=
+        unpack("V8",substr($elf,$shoff+$i*$shentsize,32));
+    push @sh,\%s;
+};
+
+my $base;
+for (@sh){
+    next unless $_->{flags} & $SHF_ALLOC && $_->{size};
+    $base=$_->{addr} if !defined($base) || $_->{addr}<$base;
+};
+die "$elffile: no loadable sections\n" unless defined $base;
+
+### Export table
+
+my @symb;
+open(my $q,"<",$exports) || die "$exports: $!";
+while(<$q>){
+    chomp;s/\r$//;
+    next if /^#/;
+    next if /^\s*$/;
+    push @symb,$_;
+};
+close($q);
+
+### Relocations
+
+my (%relocs,%imports);
+for my $rel (@sh){
+    next unless $rel->{type}==$SHT_REL;
+    next unless $sh[$rel->{info}]->{flags} & $SHF_ALLOC;
+    for (my $o=0;$o<$rel->{size};$o+=8){
+        my ($offset,$info)=unpack("VV",substr($elf,$rel->{offset}+$o,8));
+        my $type=$info & 0xff;
+        die "$elffile: unsupported relocation R_ARM_$unsupported{$type}\n"
+            if $unsupported{$type};
+        next unless $type==$R_ARM_ABS32 || $type==$R_ARM_TARGET1;
+        my $off=$offset-$base;
+        next if $off<0 || $off+4>$size;
+        my ($word)=unpack("V",substr($bin,$off,4));
+        if($word>=$IMPORT && $word<$IMPORT+4*@symb){
+            die "$elffile: unaligned import at $off\n" if $off & 3;
+            $imports{$off}=($word-$IMPORT)>>2;
+            next;
+        };
+        next if $word<$base || $word>$base+$size;
+        die "$elffile: unaligned relocation at $off\n" if $off & 3;
+        $relocs{$off}=1;
+    };
+};
+my $reloc=pack("v*",sort { $a <=> $b } keys %relocs);
+$reloc.=pack("vv",$_,$imports{$_}) for sort { $a <=> $b } keys %imports;
+
+# same as in mktable.pl: over the exports up to the last one imported
+my $last=-1;
+for (values %imports){
+    $last=$_ if $_>$last;
+};
+my $hash=0x811c9dc5;
+for (map {"$_\n"} @symb[0..$last]){
+    for (unpack("C*",$_)){
+        $hash=(($hash^$_)*0x01000193)&0xffffffff;
+    };
+};
+
+### Compression
+
+# Greedy LZ4-style sequences: token (literals<<4 | matchlen-4), literal
+# count extension, literals, 16 bit offset, match length extension.
+# The last sequence carries literals only.
+
+my $MINMATCH=4;
+
+sub lenext {
+    my $len=shift;
+    my $out="";
+    return $out if $len<15;
+    $len-=15;
+    while($len>=255){ $out.="\xff"; $len-=255; };
+    return $out.chr($len);
+}
+
+sub compress {
+    my $in=shift;
+    my $n=length($in);
+    my (%chain,$out,@seq);
+    my ($pos,$lit)=(0,0);
+    while($pos<$n){
+        my ($best,$boff,$tries)=(0,0,0);
+        if($pos+$MINMATCH<=$n){
+            for my $cand (@{$chain{substr($in,$pos,$MINMATCH)}||[]}){
+                last if ++$tries>64 || $pos-$cand>0xffff;
+                my $len=$MINMATCH;
+                $len++ while $pos+$len<$n
+                    && substr($in,$cand+$len,1) eq substr($in,$pos+$len,1);
+                ($best,$boff)=($len,$pos-$cand) if $len>$best;
+            };
+        };
+        my $step=$best>=$MINMATCH ? $best : 1;
+        for my $p ($pos..$pos+$step-1){
+            last if $p+$MINMATCH>$n;
+            unshift @{$chain{substr($in,$p,$MINMATCH)}},$p;
+        };
+        if($best>=$MINMATCH){
+            push @seq,[$lit,$pos-$lit,$best,$boff];
+            $lit=0;
+        }else{
+            $lit++;
+        };
+        $pos+=$step;
+    };
+    push @seq,[$lit,$n-$lit,0,0];
+
+    # Encrypted images are unpacked in place from the end of the window,
+    # so the output must never overtake the input.
+    my $filesize=$HDRSIZE+length($reloc); # header, relocs, imports
+    my $op=0;
+    for my $s (@seq){
+        my ($nlit,$lpos,$mlen,$moff)=@$s;
+        my $last=($s==$seq[-1]);
+        my $tok=($nlit<15?$nlit:15)<<4;
+        $tok|=($mlen-$MINMATCH<15?$mlen-$MINMATCH:15) unless $last;
+        my $seqout=chr($tok).lenext($nlit).substr($in,$lpos,$nlit);
+        $seqout.=pack("v",$moff).lenext($mlen-$MINMATCH) unless $last;
+        $out.=$seqout;
+        $op+=$nlit+$mlen;
+        push @{$s},length($out),$op;
+    };
+    $filesize+=length($out);
+    $filesize=(($filesize+15)&~15)+16;  # xxtea padding and MAC
+    my $start=$ramcode-$filesize+$HDRSIZE;
+    for (@seq){
+        my ($ip,$op)=@{$_}[4,5];
+        return undef if $start<0 || $op>$start+$ip;
+    };
+    return $out;
+}
+
+my $body=compress($bin);
+my $packed=0;
+if(defined($body) && length($body)<$size){
+    $packed=length($body);
+}else{
+    $body=$bin;
+};
+
+open(my $out,">",$outfile) || die "$outfile: $!";
+binmode($out);
+print $out pack("VVVvvvv",$MAGIC,$base,$hash,$size,$packed,
+    scalar(keys %relocs),scalar(keys %imports));
+print $out $body;
+print $out $reloc;
+close($out);
+
+printf "%s: %d -> %d bytes, %d relocs, %d imports\n",$outfile,$size,
+    $HDRSIZE+length($body)+length($reloc),
+    scalar(keys %relocs),scalar(keys %imports);
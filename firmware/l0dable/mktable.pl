@@ -24,6 +24,29 @@ while(<Q>){
 };
 close(Q);
 
+# Functions that l0dables call directly, bound at load time
+my %direct;
+open(Q,"<","l0dable/IMPORTS") || die "$!";
+while(<Q>){
+    chomp;s/\r$//;
+    next if /^#/;
+    next if /^\s*$/;
+    $direct{$_}=1;
+};
+close(Q);
+
+# FNV-1a over the export list up to each directly bound function. A
+# l0dable with imports carries the one up to its last import, so
+# appending to EXPORTS does not break it.
+my @hashes;
+my $hash=0x811c9dc5;
+for my $idx (0..$#symb){
+    for (unpack("C*","$symb[$idx]\n")){
+        $hash=(($hash^$_)*0x01000193)&0xffffffff;
+    };
+    push @hashes,$hash if $direct{$symb[$idx]};
+};
+
 $\="\n";
 
 open (C,">","table.c")||die;
@@ -33,11 +56,15 @@ open (H,">","table.h")||die;
 print H "#include <sysdefs.h>";
 
 open (I,">","$DIR/usetable.h")||die;
+
+open (L,">","$DIR/imports.ld")||die;
+print L "/* placeholders for directly bound imports, see mkc0d.pl */";
 print I "extern const void * TheTable[];";
 
 print I "";
 
 my %types;
+my %decls;
 my %files;
 my %variable;
 
@@ -51,6 +78,7 @@ sub wanted {
 		chomp;s/\r$//;
 		if(m!^[^(]* ([\w]+)\s*\(.*\);\s*(//.*)?(/\*[^/]*\*/)?$!){
             $id=$1;
+            ($decls{$id}=$_)=~s!\s*(//.*|/\*.*)?$!!;
             s/$id/(*)/;
             s/;//;
             s!//.*!!;
@@ -104,11 +132,22 @@ for my $idx (0..$#symb){
     }else{
         print C "$_,";
     };
+    if($direct{$_} && !$variable{$_}){
+        print I "$decls{$_}";
+        printf L "%s = 0x%08x;\n",$_,0xf0000000+4*$idx;
+        next;
+    };
     print I "#define $_ ($types{$_}(TheTable[$idx]))";
 };
 
 print C "};";
+print C "";
+print C "const uint32_t TheTableHash[]={";
+printf C "0x%08x,\n",$_ for @hashes;
+print C "};";
+printf C "const uint8_t TheTableHashes = %d;\n",scalar(@hashes);
 
+close(L);
 close(I);
 close(H);
 close(C);
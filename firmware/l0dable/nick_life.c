@@ -60,7 +60,7 @@ void ram(void) {
     lcdClear();
     setExtFont(GLOBAL(nickfont));
     
-    nickwidth=DoString(nickx,nicky,GLOBAL(nickname));
+    nickwidth=getStringWidth(GLOBAL(nickname));
     if(nickwidth<50)nickoff=30;
     nickheight=getFontHeight();
 
@@ -39,12 +39,12 @@ void ram(void) {
       lcdSetPixel(alive,9,1);
 
       int ticks=64>>yscale;
-      for(i=10;i<60;i++) lcdSetPixel(7,i,0);
+      lcdVSpan(7,10,60,BLIT_CLEAR);
       for(i=0;i<ticks;i++)
 	lcdSetPixel(7,10+50*i/ticks,1);
 
       ticks=64>>xs;
-      for(i=10;i<90;i++) lcdSetPixel(i,59,0);
+      lcdHSpan(10,90,59,BLIT_CLEAR);
       for(i=0;i<ticks;i++)
 	lcdSetPixel(10+80*i/ticks,59,1);
 
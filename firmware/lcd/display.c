@@ -4,6 +4,7 @@
 #include <sysdefs.h>
 #include "lpc134x.h"
 #include "core/ssp/ssp.h"
+#include "core/timer32/timer32.h"
 #include "gpio/gpio.h"
 #include "basic/basic.h"
 #include "basic/config.h"
@@ -22,10 +23,25 @@ uint32_t intstatus; // Caches USB interrupt state
                     // (need to disable MSC while displaying)
 uint8_t displayType;
 
+/* N1600 state, see lcd_display_color() */
+static uint32_t lcd_pagehash[RESY_B];
+static uint8_t lcd_shown=0xff;      /* invert/mirror on the panel, 0xff: none */
+
+static uint8_t *lcd_gray;           /* bitplanes, see lcdGrayStart() */
+
 #define TYPE_CMD    0
 #define TYPE_DATA   1
 
+/* Like sspSelect(), but the frame size has to change with interrupts
+ * off as well, or a gray tick could start a transfer in between */
 static void lcd_select() {
+    for(;;){
+        sspWait();
+        __disable_irq();
+        if(!sspBackground)
+            break;
+        __enable_irq();
+    };
 #if CFG_USBMSC
     if(usbMSCenabled){
         intstatus=USB_DEVINTEN;
@@ -38,6 +54,7 @@ static void lcd_select() {
                   | SSP_SSP0CR0_SCR_8);             // Serial clock rate = 8
     SSP_SSP0CR0 = configReg;
     gpioSetValue(RB_LCD_CS, 0);
+    __enable_irq();
 }
 
 static void lcd_deselect() {
@@ -187,6 +204,7 @@ void lcdInit(void) {
         int i = 0;
         lcdWrite(TYPE_CMD,0x01); //sw reset
         delayms(10);
+        lcd_shown=0xff;
 
         while(i<sizeof(initseq_d)){
             lcdWrite(initseq_c&1, initseq_d[i++]);
@@ -227,24 +245,328 @@ bool lcdGetPixel(char x, char y){
     return byte & (1 << y_off);
 }
 
+/* Where x,y is in lcdBuffer, as in lcdSetPixel() */
+#define LCD_PAGE(y) ((RESY-1-(y))>>3)
+#define LCD_BIT(y)  (1<<((RESY-1-(y))&7))
+#define LCD_COL(x)  (RESX-1-(x))
+
+static void lcd_op(uint8_t *d, uint8_t m, uint8_t mode){
+    if(mode==BLIT_OR)
+        *d|=m;
+    else if(mode==BLIT_XOR)
+        *d^=m;
+    else
+        *d&=~m;
+}
+
+/* Pixels x0 to x1-1 of row y: one byte per column */
+void lcdHSpan(int x0, int x1, int y, uint8_t mode){
+    uint8_t *d, m;
+    int n;
+
+    if(y<0 || y>=RESY)
+        return;
+    if(x0<0)
+        x0=0;
+    if(x1>RESX)
+        x1=RESX;
+    if(x0>=x1)
+        return;
+
+    m=LCD_BIT(y);
+    d=lcdBuffer+LCD_PAGE(y)*RESX+LCD_COL(x1-1);
+    n=x1-x0;
+    switch(mode){
+        case BLIT_OR:
+            while(n--) *d++|=m;
+            break;
+        case BLIT_XOR:
+            while(n--) *d++^=m;
+            break;
+        case BLIT_CLEAR:
+            m=~m;
+            while(n--) *d++&=m;
+            break;
+    };
+}
+
+/* One masked byte per page and column */
+void lcdFillRect(int x, int y, int w, int h, uint8_t mode){
+    int r0, r1, p, c, n;
+    uint8_t m;
+
+    if(x<0){
+        w+=x;
+        x=0;
+    };
+    if(y<0){
+        h+=y;
+        y=0;
+    };
+    if(x+w>RESX)
+        w=RESX-x;
+    if(y+h>RESY)
+        h=RESY-y;
+    if(w<=0 || h<=0)
+        return;
+
+    r0=RESY-y-h;            /* rows counted from the bottom, r1 inclusive */
+    r1=RESY-1-y;
+    c=LCD_COL(x+w-1);
+    for(p=r0>>3;p<=r1>>3;p++){
+        m=0xff;
+        if(p==r0>>3)
+            m&=0xff<<(r0&7);
+        if(p==r1>>3)
+            m&=0xff>>(7-(r1&7));
+        for(n=0;n<w;n++)
+            lcd_op(lcdBuffer+p*RESX+c+n, m, mode);
+    };
+}
+
+/* Pixels y0 to y1-1 of column x */
+void lcdVSpan(int x, int y0, int y1, uint8_t mode){
+    lcdFillRect(x, y0, 1, y1-y0, mode);
+}
+
+void lcdRect(int x, int y, int w, int h, uint8_t mode){
+    if(w<=0 || h<=0)
+        return;
+    lcdHSpan(x, x+w, y, mode);
+    if(h>1)
+        lcdHSpan(x, x+w, y+h-1, mode);
+    lcdVSpan(x, y+1, y+h-1, mode);
+    if(w>1)
+        lcdVSpan(x+w-1, y+1, y+h-1, mode);
+}
+
+/* Bresenham, both ends included */
+void lcdLine(int x0, int y0, int x1, int y1, uint8_t mode){
+    int dx, dy, sx, sy, err, e2;
+
+    if(y0==y1){
+        if(x0>x1){ dx=x0; x0=x1; x1=dx; };
+        lcdHSpan(x0, x1+1, y0, mode);
+        return;
+    };
+    if(x0==x1){
+        if(y0>y1){ dy=y0; y0=y1; y1=dy; };
+        lcdVSpan(x0, y0, y1+1, mode);
+        return;
+    };
+
+    dx=x1>x0?x1-x0:x0-x1;
+    dy=y1>y0?y0-y1:y1-y0;
+    sx=x0<x1?1:-1;
+    sy=y0<y1?1:-1;
+    err=dx+dy;
+    while(1){
+        if(x0>=0 && x0<RESX && y0>=0 && y0<RESY)
+            lcd_op(lcdBuffer+LCD_PAGE(y0)*RESX+LCD_COL(x0), LCD_BIT(y0), mode);
+        if(x0==x1 && y0==y1)
+            break;
+        e2=2*err;
+        if(e2>=dy){
+            err+=dy;
+            x0+=sx;
+        };
+        if(e2<=dx){
+            err+=dx;
+            y0+=sy;
+        };
+    };
+}
+
+static void blit_span(uint8_t *d, const uint8_t *s, uint8_t n,
+        uint8_t l, uint8_t r, uint8_t mask, uint8_t mode){
+    uint8_t v;
+
+    switch(mode){
+        case BLIT_OR:
+            while(n--){ v=(*s++<<l)>>r; *d++|=v&mask; };
+            break;
+        case BLIT_XOR:
+            while(n--){ v=(*s++<<l)>>r; *d++^=v&mask; };
+            break;
+        case BLIT_CLEAR:
+            while(n--){ v=(*s++<<l)>>r; *d++&=~(v&mask); };
+            break;
+    };
+}
+
+/* Draw a sprite with its top left corner at x,y, clipped to the screen.
+ * Each sprite page lands on at most two pages of lcdBuffer, so this is
+ * a few byte operations per column of 8 pixels. */
+void lcdBlit(const uint8_t *sprite, int x, int y, uint8_t mode){
+    uint8_t w=sprite[0], h=sprite[1];
+    const uint8_t *bits=sprite+2;
+    int bottom=RESY-y-h;                    /* lowest row, from the bottom */
+    int page=((bottom+8*RESY_B)>>3)-RESY_B; /* floor(bottom/8) */
+    uint8_t shift=bottom&7;
+    int col=RESX-x-w;                       /* buffer column of the right edge */
+    int c0=0, c1=w;
+    int p, dp;
+
+    if(col<0)
+        c0=-col;
+    if(col+w>RESX)
+        c1=RESX-col;
+    if(c0>=c1)
+        return;
+
+    for(p=0;p<(h+7)/8;p++,bits+=w){
+        dp=page+p;
+        if(dp>=0 && dp<RESY_B)
+            blit_span(lcdBuffer+dp*RESX+col+c0, bits+c0, c1-c0, shift, 0,
+                    dp==RESY_B-1?(1<<(RESY-8*(RESY_B-1)))-1:0xff, mode);
+        dp++;
+        if(shift && dp>=0 && dp<RESY_B)
+            blit_span(lcdBuffer+dp*RESX+col+c0, bits+c0, c1-c0, 0, 8-shift,
+                    dp==RESY_B-1?(1<<(RESY-8*(RESY_B-1)))-1:0xff, mode);
+    };
+}
+
+
+/* The N1600 is a 98x70 RGB565 panel, mounted upside down: its first
+ * row and column are the frame around the bottom right pixel, after
+ * which its rows and columns run along the bits and columns of
+ * lcdBuffer. So a row is unpacked straight from one page, with a
+ * palette of ready-made 9-bit frames, and only runs of pages that
+ * changed since the last frame (going by a hash) are sent, through a
+ * CASET/PASET window. */
+
+#define N1600_CASET 0x2A
+#define N1600_PASET 0x2B
+#define N1600_RAMWR 0x2C
+
+#define RGB565(r,g,b) ((((r)&0xF8)<<8) | (((g)&0xFC)<<3) | (((b)&0xF8)>>3))
+#define COLOR_FG    RGB565(0x00,0x60,0x00)
+#define COLOR_BG    RGB565(0xFF,0xFF,0xFF)
+#define COLOR_FRAME RGB565(0x00,0x00,0x80)
+
+/* Queue a 9-bit frame without waiting for it to go out */
+static void lcd_stream(uint16_t frame){
+    while(!(SSP_SSP0SR & SSP_SSP0SR_TNF_NOTFULL))
+        ;
+    SSP_SSP0DR = frame;
+    while(SSP_SSP0SR & SSP_SSP0SR_RNE_NOTEMPTY)
+        frame = SSP_SSP0DR;
+}
+
+static void lcd_flush(void){
+    uint16_t frame;
+
+    while(SSP_SSP0SR & SSP_SSP0SR_BSY_BUSY)
+        ;
+    while(SSP_SSP0SR & SSP_SSP0SR_RNE_NOTEMPTY)
+        frame = SSP_SSP0DR;
+    (void)frame;
+}
+
+static void lcd_color(uint16_t color){
+    lcd_stream(TYPE_DATA<<8 | color>>8);
+    lcd_stream(TYPE_DATA<<8 | (color&0xFF));
+}
+
+static void lcd_window(uint8_t x0, uint8_t x1, uint8_t y0, uint8_t y1){
+    lcd_stream(TYPE_CMD<<8 | N1600_CASET);
+    lcd_stream(TYPE_DATA<<8 | x0);
+    lcd_stream(TYPE_DATA<<8 | x1);
+    lcd_stream(TYPE_CMD<<8 | N1600_PASET);
+    lcd_stream(TYPE_DATA<<8 | y0);
+    lcd_stream(TYPE_DATA<<8 | y1);
+    lcd_stream(TYPE_CMD<<8 | N1600_RAMWR);
+}
 
-// Color display hepler functions
-static void _helper_pixel16(uint16_t color){
-    lcdWrite(TYPE_DATA,color>>8);
-    lcdWrite(TYPE_DATA,color&0xFF);
+static uint32_t lcd_hash(const uint8_t *p){
+    uint32_t h=2166136261u;     /* FNV-1a */
+    uint8_t i;
+
+    for(i=0;i<RESX;i++)
+        h=(h^p[i])*16777619u;
+    return h;
 }
 
-static void _helper_hline(uint16_t color){
-    for(int cx=0;cx<98;cx++)
-        _helper_pixel16(color);
+/* Panel rows of lcdBuffer rows r0 to r1-1, counted from the bottom */
+static void lcd_color_rows(uint8_t r0, uint8_t r1, uint8_t frame){
+    uint16_t pal[2][2];
+    const uint8_t *src;
+    const uint16_t *v;
+    uint8_t r, bit, c;
+
+    pal[0][0]=TYPE_DATA<<8 | COLOR_BG>>8;
+    pal[0][1]=TYPE_DATA<<8 | (COLOR_BG&0xFF);
+    pal[1][0]=TYPE_DATA<<8 | COLOR_FG>>8;
+    pal[1][1]=TYPE_DATA<<8 | (COLOR_FG&0xFF);
+    if(GLOBAL(lcdinvert)){
+        pal[0][0]=pal[1][0]; pal[0][1]=pal[1][1];
+        pal[1][0]=TYPE_DATA<<8 | COLOR_BG>>8;
+        pal[1][1]=TYPE_DATA<<8 | (COLOR_BG&0xFF);
+    };
+
+    for(r=r0;r<r1;r++){
+        src=lcdBuffer+(r>>3)*RESX;
+        bit=r&7;
+        if(frame)
+            lcd_color(COLOR_FRAME);
+        if(GLOBAL(lcdmirror)){
+            for(c=RESX;c-->0;){
+                v=pal[(src[c]>>bit)&1];
+                lcd_stream(v[0]);
+                lcd_stream(v[1]);
+            };
+        }else{
+            for(c=0;c<RESX;c++){
+                v=pal[(src[c]>>bit)&1];
+                lcd_stream(v[0]);
+                lcd_stream(v[1]);
+            };
+        };
+        if(frame)
+            lcd_color(COLOR_FRAME);
+    };
 }
 
-#define THECOLOR_R 0x0
-#define THECOLOR_G 0x60
-#define THECOLOR_B 0x0
+static void lcd_display_color(void){
+    uint8_t shown=(GLOBAL(lcdinvert)?1:0) | (GLOBAL(lcdmirror)?2:0);
+    uint8_t p, p0, dirty[RESY_B];
+    uint32_t h;
+    uint8_t c;
+
+    for(p=0;p<RESY_B;p++){
+        h=lcd_hash(lcdBuffer+p*RESX);
+        dirty[p]=(h!=lcd_pagehash[p]);
+        lcd_pagehash[p]=h;
+    };
+
+    if(shown!=lcd_shown){
+        lcd_shown=shown;
+        lcd_window(0, RESX+1, 0, RESY+1);
+        for(c=0;c<RESX+2;c++)
+            lcd_color(COLOR_FRAME);
+        lcd_color_rows(0, RESY, 1);
+        for(c=0;c<RESX+2;c++)
+            lcd_color(COLOR_FRAME);
+        lcd_flush();
+        return;
+    };
+
+    for(p=0;p<RESY_B;p++){
+        if(!dirty[p])
+            continue;
+        for(p0=p;p+1<RESY_B && dirty[p+1];p++)
+            ;
+        lcd_window(1, RESX, 8*p0+1, (8*p+8<RESY?8*p+8:RESY));
+        lcd_color_rows(8*p0, (8*p+8<RESY?8*p+8:RESY), 0);
+    };
+    lcd_flush();
+}
 
 void lcdDisplay(void) {
     char byte;
+    if(lcd_gray)
+        return;
+    TRACE_BEGIN(TR_LCD,0);
     lcd_select();
 
     if(displayType==DISPLAY_N1200){
@@ -266,49 +588,307 @@ void lcdDisplay(void) {
           }
       }
     } else { /* displayType==DISPLAY_N1600 */
-      unsigned char r=THECOLOR_R,g=THECOLOR_G,b=THECOLOR_B;
-      unsigned char br=0xFF, bg=0xFF, bb=0xFF;
-      unsigned char frame_r=0x00, frame_g=0x00, frame_b=0x80;
-      uint16_t color,framecolor,backcolor;
-      uint16_t x,y;
-      bool px;
-      uint16_t actualcolor;
-      color = ((r&0xF8) << 8) | ((g&0xFC)<<3) | ((b&0xF8) >> 3);
-      framecolor= ((frame_r&0xF8) << 8) | ((frame_g&0xFC)<<3) | ((frame_b&0xF8) >> 3);
-      backcolor= ((br&0xF8) << 8) | ((bg&0xFC)<<3) | ((bb&0xF8) >> 3);
- 
-      lcdWrite(TYPE_CMD,0x2C);
-  
-      //top line of the frame...
-      _helper_hline(framecolor);
-  
-      for(y=RESY;y>0;y--){
-          //left line of the frame
-          _helper_pixel16(framecolor);
-  
-          for(x=RESX;x>0;x--){
-              if(GLOBAL(lcdmirror))
-                  px=lcdGetPixel(RESX-x+1,y-1);
-              else
-                  px=lcdGetPixel(x-1,y-1);
-                  
-              if((!px)^(!GLOBAL(lcdinvert))) actualcolor=color;
-              else actualcolor=backcolor; /* white */
-  
-              _helper_pixel16(actualcolor);
-          }
-          //right line of the frame
-          _helper_pixel16(framecolor);
-      }
-      
-      //bottom line of the frame
-      _helper_hline(framecolor);
-      }
+      lcd_display_color();
+    }
     lcd_deselect();
+    TRACE_END(TR_LCD,0);
 }
 
 void lcdRefresh() __attribute__ ((weak, alias ("lcdDisplay")));
 
+/* Like lcdDisplay() when only the pages in mask (bit p for page p of
+ * lcdBuffer) changed. The N1600 finds those by itself. */
+void lcdDisplayPages(uint16_t mask) {
+    uint8_t page, i;
+    char byte;
+
+    if(displayType!=DISPLAY_N1200){
+        lcdDisplay();
+        return;
+    };
+    if(lcd_gray || !mask)
+        return;
+    TRACE_BEGIN(TR_LCD,0);
+    lcd_select();
+    for(page=0;page<RESY_B;page++){
+        if(!(mask & 1<<page))
+            continue;
+        lcdWrite(TYPE_CMD,0xB0|page);
+        lcdWrite(TYPE_CMD,0x10);
+        lcdWrite(TYPE_CMD,0x00);
+        for(i=0;i<RESX;i++){
+            if(GLOBAL(lcdmirror))
+                byte=lcdBuffer[page*RESX+RESX-1-i];
+            else
+                byte=lcdBuffer[page*RESX+i];
+            if(GLOBAL(lcdinvert))
+                byte=~byte;
+            lcdWrite(TYPE_DATA,byte);
+        };
+    };
+    lcd_deselect();
+    TRACE_END(TR_LCD,0);
+}
+
+/* Sending in the background: lcd_send() starts a picture going out
+ * from the SSP interrupt and returns at once. The bus is busy
+ * meanwhile, other drivers wait for it in sspSelect(). The N1600 always
+ * gets the whole panel this way, with a color for each gray level.
+ *
+ * Double buffering: lcdFlip() copies lcdBuffer into the second buffer
+ * the app handed to lcdDoubleBuffer() and sends that while the next
+ * picture is drawn into lcdBuffer. */
+static uint8_t *lcd_front;
+static const uint8_t *lcd_src;
+static uint8_t lcd_planes;          /* bitplanes in lcd_src */
+static uint8_t lcd_xor, lcd_mirror;
+static uint16_t lcd_pal[16];        /* N1600, color of each level */
+static uint16_t lcd_cmd[8];
+static uint8_t lcd_ncmd, lcd_cmdpos;
+static uint8_t lcd_row, lcd_col;    /* N1200: page, N1600: with frame */
+static uint16_t lcd_lo;             /* N1600, second half of the pixel */
+
+static uint8_t lcd_next(uint16_t *frame){
+    const uint8_t *src;
+    uint16_t color;
+    uint8_t r, c, p, level;
+
+    if(lcd_cmdpos<lcd_ncmd){
+        *frame=lcd_cmd[lcd_cmdpos++];
+        return 1;
+    };
+    if(displayType==DISPLAY_N1200){
+        if(lcd_row>=RESY_B)
+            return 0;
+        c=lcd_mirror ? RESX-1-lcd_col : lcd_col;
+        *frame=TYPE_DATA<<8 | (lcd_src[lcd_row*RESX+c]^lcd_xor);
+        if(++lcd_col>=RESX){
+            lcd_col=0;
+            lcd_row++;
+        };
+        return 1;
+    };
+    if(lcd_lo){
+        *frame=lcd_lo;
+        lcd_lo=0;
+        return 1;
+    };
+    if(lcd_row>RESY+1)
+        return 0;
+    r=lcd_row-1;
+    c=lcd_col-1;
+    if(!lcd_row || r>=RESY || !lcd_col || c>=RESX)
+        color=COLOR_FRAME;
+    else{
+        if(lcd_mirror)
+            c=RESX-1-c;
+        src=lcd_src+(r>>3)*RESX+c;
+        level=0;
+        for(p=0;p<lcd_planes;p++,src+=RESX*RESY_B)
+            level|=((*src>>(r&7))&1)<<p;
+        color=lcd_pal[level];
+    };
+    if(++lcd_col>RESX+1){
+        lcd_col=0;
+        lcd_row++;
+    };
+    *frame=TYPE_DATA<<8 | color>>8;
+    lcd_lo=TYPE_DATA<<8 | (color&0xFF);
+    return 1;
+}
+
+/* SSP interrupt, whenever the Tx FIFO is half empty */
+static void lcd_refill(void){
+    uint16_t frame;
+
+    while(SSP_SSP0SR & SSP_SSP0SR_RNE_NOTEMPTY)
+        frame = SSP_SSP0DR;
+    while(SSP_SSP0SR & SSP_SSP0SR_TNF_NOTFULL){
+        if(!lcd_next(&frame)){
+            SSP_SSP0IMSC &= ~SSP_SSP0IMSC_TXIM_MASK;
+            lcd_flush();
+            lcd_deselect();
+            sspBackground=NULL;
+            TRACE_END(TR_LCD,1);
+            return;
+        };
+        SSP_SSP0DR = frame;
+    };
+}
+
+/* Mix two RGB565 colors, l/m of the way from a to b */
+static uint16_t lcd_blend(uint16_t a, uint16_t b, uint8_t l, uint8_t m){
+    uint16_t r, g, bl;
+
+    r=((a>>11)*(m-l)+(b>>11)*l)/m;
+    g=(((a>>5)&0x3F)*(m-l)+((b>>5)&0x3F)*l)/m;
+    bl=((a&0x1F)*(m-l)+(b&0x1F)*l)/m;
+    return r<<11 | g<<5 | bl;
+}
+
+/* The bus must be free */
+static void lcd_send(const uint8_t *src, uint8_t planes){
+    uint8_t max=(1<<planes)-1, l;
+
+    TRACE_BEGIN(TR_LCD,1);
+    lcd_src=src;
+    lcd_planes=planes;
+    lcd_mirror=GLOBAL(lcdmirror);
+    lcd_xor=GLOBAL(lcdinvert)?0xff:0;
+    lcd_cmdpos=0;
+    lcd_row=lcd_col=0;
+    if(displayType==DISPLAY_N1200){
+        lcd_cmd[0]=TYPE_CMD<<8 | 0xB0;
+        lcd_cmd[1]=TYPE_CMD<<8 | 0x10;
+        lcd_cmd[2]=TYPE_CMD<<8 | 0x00;
+        lcd_ncmd=3;
+    }else{
+        lcd_cmd[0]=TYPE_CMD<<8 | N1600_CASET;
+        lcd_cmd[1]=TYPE_DATA<<8 | 0;
+        lcd_cmd[2]=TYPE_DATA<<8 | (RESX+1);
+        lcd_cmd[3]=TYPE_CMD<<8 | N1600_PASET;
+        lcd_cmd[4]=TYPE_DATA<<8 | 0;
+        lcd_cmd[5]=TYPE_DATA<<8 | (RESY+1);
+        lcd_cmd[6]=TYPE_CMD<<8 | N1600_RAMWR;
+        lcd_ncmd=7;
+        lcd_lo=0;
+        for(l=0;l<=max;l++)
+            lcd_pal[l]=lcd_blend(COLOR_BG, COLOR_FG, lcd_xor?max-l:l, max);
+        lcd_shown=0xff;     /* lcdDisplay() cannot trust its hashes */
+    };
+
+    lcd_select();
+    sspBackground=&lcd_refill;
+    SSP_SSP0IMSC |= SSP_SSP0IMSC_TXIM_ENBL;
+}
+
+/* front: RESX*RESY_B bytes of the app's RAM, NULL to stop */
+void lcdDoubleBuffer(uint8_t *front){
+    sspWait();
+    lcd_front=front;
+}
+
+void lcdFlip(void){
+    if(!lcd_front || lcd_gray){
+        lcdDisplay();
+        return;
+    };
+    sspWait();
+    memcpy(lcd_front,lcdBuffer,RESX*RESY_B);
+    lcd_send(lcd_front,1);
+}
+
+/* Until the last lcdFlip() is on the display */
+void lcdFlipWait(void){
+    sspWait();
+}
+
+/* Grayscale: the app draws into bits bitplanes of RESX*RESY_B bytes,
+ * plane i weighing 1<<i, and CT32B1 refreshes the display from them.
+ * The N1200 gets one plane per tick, plane i in 1<<i of every
+ * (1<<bits)-1 ticks, spread out like the bits of a counter, so a pixel
+ * is dark level/((1<<bits)-1) of the time. The N1600 shows the levels
+ * as colors and is refreshed at LCD_GRAY_N1600_HZ only. A tick is
+ * skipped while the bus is busy. lcdDisplay() and lcdFlip() do nothing
+ * in the meantime, and the idle loop cannot use CT32B1 to sleep. */
+#define LCD_GRAY_N1600_HZ 10
+
+static uint8_t lcd_graybits, lcd_grayk;
+
+/* CT32B1 interrupt */
+static void lcd_gray_tick(void){
+    uint8_t k, plane;
+
+    if(sspBackground || !gpioGetValue(RB_LCD_CS) ||
+            !gpioGetValue(RB_SPI_NRF_CS) || !gpioGetValue(RB_SPI_CS_DF))
+        return;
+    if(displayType==DISPLAY_N1600){
+        lcd_send(lcd_gray,lcd_graybits);
+        return;
+    };
+    lcd_grayk=lcd_grayk%((1<<lcd_graybits)-1)+1;
+    plane=lcd_graybits-1;
+    for(k=lcd_grayk;!(k&1);k>>=1)
+        plane--;
+    lcd_send(lcd_gray+plane*RESX*RESY_B,1);
+}
+
+/* planes: bits*RESX*RESY_B bytes of the app's RAM, bits 1..4 */
+void lcdGrayStart(uint8_t *planes, uint8_t bits, uint16_t hz){
+    lcdGrayStop();
+    if(!planes || !bits || bits>4 || !hz)
+        return;
+    if(displayType==DISPLAY_N1600)
+        hz=LCD_GRAY_N1600_HZ;
+    sspWait();
+    lcd_gray=planes;
+    lcd_graybits=bits;
+    lcd_grayk=0;
+
+    SCB_SYSAHBCLKCTRL |= (SCB_SYSAHBCLKCTRL_CT32B1);
+    TMR_TMR32B1TCR = TMR_TMR32B1TCR_COUNTERENABLE_DISABLED;
+    TMR_TMR32B1PR = CFG_CPU_CCLK/1000000 - 1;
+    TMR_TMR32B1PC = 0;
+    TMR_TMR32B1TC = 0;
+    TMR_TMR32B1MR0 = 1000000/hz;
+    TMR_TMR32B1MCR = TMR_TMR32B1MCR_MR0_INT_ENABLED | TMR_TMR32B1MCR_MR0_RESET_ENABLED;
+    timer32Callback1=&lcd_gray_tick;
+    NVIC_EnableIRQ(TIMER_32_1_IRQn);
+    TMR_TMR32B1TCR = TMR_TMR32B1TCR_COUNTERENABLE_ENABLED;
+}
+
+void lcdGrayStop(void){
+    if(!lcd_gray)
+        return;
+    TMR_TMR32B1TCR = TMR_TMR32B1TCR_COUNTERENABLE_DISABLED;
+    timer32Callback1=NULL;
+    sspWait();
+    lcd_gray=NULL;
+}
+
+/* level 0 is blank, (1<<bits)-1 black */
+void lcdGraySetPixel(int x, int y, uint8_t level){
+    uint8_t *b;
+    uint8_t bit, p;
+
+    if(!lcd_gray || x<0 || x>=RESX || y<0 || y>=RESY)
+        return;
+    b=lcd_gray+LCD_PAGE(y)*RESX+LCD_COL(x);
+    bit=LCD_BIT(y);
+    for(p=0;p<lcd_graybits;p++,b+=RESX*RESY_B,level>>=1)
+        if(level&1)
+            *b|=bit;
+        else
+            *b&=~bit;
+}
+
+uint8_t lcdGrayGetPixel(int x, int y){
+    const uint8_t *b;
+    uint8_t bit, p, level=0;
+
+    if(!lcd_gray || x<0 || x>=RESX || y<0 || y>=RESY)
+        return 0;
+    b=lcd_gray+LCD_PAGE(y)*RESX+LCD_COL(x);
+    bit=LCD_BIT(y);
+    for(p=0;p<lcd_graybits;p++,b+=RESX*RESY_B)
+        if(*b&bit)
+            level|=1<<p;
+    return level;
+}
+
+void lcdGrayFill(uint8_t level){
+    uint8_t p;
+
+    if(!lcd_gray)
+        return;
+    for(p=0;p<lcd_graybits;p++)
+        memset(lcd_gray+p*RESX*RESY_B,(level>>p)&1?0xff:0,RESX*RESY_B);
+}
+
+/* Ticks the idle loop may sleep with CT32B1 */
+uint32_t lcd_deadline(uint32_t max){
+    return lcd_gray?0:max;
+}
 inline void lcdInvert(void) {
     GLOBAL(lcdinvert)=!GLOBAL(lcdinvert);
 }
@@ -343,92 +923,116 @@ void __attribute__((__deprecated__)) lcdToggleFlag(int flag) {
         GLOBAL(lcdinvert)=!GLOBAL(lcdinvert);
 }
 
-void lcdShiftH(bool right, bool wrap) {
-	uint8_t tmp;
-	for (int yb = 0; yb<RESY_B; yb++) {
-		if (right) {
-			tmp = lcdBuffer[yb*RESX];
-			memmove(lcdBuffer + yb*RESX,lcdBuffer + yb*RESX+1 ,RESX-1);
-            lcdBuffer[yb*RESX+(RESX-1)] = wrap?tmp:0;
-		} else {
-			tmp = lcdBuffer[yb*RESX+(RESX-1)];
-			memmove(lcdBuffer + yb*RESX+1,lcdBuffer + yb*RESX ,RESX-1);
-			lcdBuffer[yb*RESX] = wrap?tmp:0;
-		}
-	}
-}
-
-void lcdShiftV8(bool up, bool wrap) {
-	uint8_t tmp[RESX];
-	if (!up) {
-		if (wrap)
-            memmove(tmp, lcdBuffer, RESX);
-        else
-            memset(tmp,0,RESX);
-		memmove(lcdBuffer,lcdBuffer+RESX ,RESX*(RESY_B-1));
-		memmove(lcdBuffer+RESX*(RESY_B-1),tmp,RESX);
-	} else {
-		if (wrap)
-            memmove(tmp, lcdBuffer+RESX*(RESY_B-1), RESX);
-        else
-            memset(tmp,0,RESX);
-		memmove(lcdBuffer+RESX,lcdBuffer ,RESX*(RESY_B-1));
-		memmove(lcdBuffer,tmp,RESX);
-	}
-}
+/* Shifts move any distance in one pass. Horizontally that is one
+ * memmove per page. Vertically each column is loaded as a bit string
+ * into 32 bit words, shifted (rotated within RESY rows when wrapping)
+ * and stored back, whatever the distance. */
+#define LCD_COLWORDS ((RESY_B+3)/4)
 
-void lcdShiftV(bool up, bool wrap) {
-	uint8_t tmp[RESX];
-	if (up) {
-		if (wrap) 
-            memmove(tmp,lcdBuffer+((RESY_B-1)*RESX),RESX);
-        else
-            memset(tmp,0,RESX);
-		for (int x = 0; x<RESX; x++){
-			for (int y = RESY_B-1; y > 0; y--){
-				lcdBuffer[x+(y*RESX)] = (lcdBuffer[x+(y*RESX)] << 1) |( lcdBuffer[x+((y-1)*RESX)] >> 7);
-			}
-			lcdBuffer[x] = ( lcdBuffer[x] << 1) | ((tmp[x]>>3)&1);
-		}
-				
-	} else {
-		if (wrap)
-            memmove(tmp,lcdBuffer,RESX);
-        else
-            memset(tmp,0,RESX);
-		for (int x = 0; x<RESX; x++){
-			for (int y = 0; y < (RESY_B-1); y++){
-				lcdBuffer[x+(y*RESX)] = (lcdBuffer[x+(y*RESX)] >> 1) |( lcdBuffer[x+((y+1)*RESX)] << 7);
-			}
-			lcdBuffer[x+((RESY_B-1)*RESX)] = ( lcdBuffer[x+((RESY_B-1)*RESX)] >> 1) | ((tmp[x]<<3)&8);
-		}	
-	}
-}	
+static void lcd_shift_cols(int n, bool wrap) {
+    uint8_t tmp[RESX];
+    uint8_t *page;
+    uint8_t right=n>0, p;
 
-void lcdShift(int x, int y, bool wrap) {
-	bool dir=true;
+    if(!right)
+        n=-n;
+    if(wrap)
+        n%=RESX;
+    else if(n>RESX)
+        n=RESX;
+    if(!n)
+        return;
 
-    if(x<0){
-        dir=false;
-        x=-x;
+    for(p=0;p<RESY_B;p++){
+        page=lcdBuffer+p*RESX;
+        if(right){
+            memcpy(tmp,page,n);
+            memmove(page,page+n,RESX-n);
+            if(wrap)
+                memcpy(page+RESX-n,tmp,n);
+            else
+                memset(page+RESX-n,0,n);
+        }else{
+            memcpy(tmp,page+RESX-n,n);
+            memmove(page+n,page,RESX-n);
+            if(wrap)
+                memcpy(page,tmp,n);
+            else
+                memset(page,0,n);
+        };
     };
+}
 
-    while(x-->0)
-        lcdShiftH(dir, wrap);
+/* d = s<<n, n < 32*LCD_COLWORDS */
+static void lcd_bits_shl(uint32_t *d, const uint32_t *s, uint8_t n) {
+    uint8_t w=n>>5, b=n&31;
+    int8_t i;
 
-    if(y<0){
-        dir=false;
-        y=-y;
-    }else{
-        dir=true;
+    for(i=LCD_COLWORDS-1;i>=0;i--){
+        d[i]=i>=w ? s[i-w]<<b : 0;
+        if(b && i>w)
+            d[i]|=s[i-w-1]>>(32-b);
     };
+}
 
-    while(y>=8){
-        y-=8;
-        lcdShiftV8(dir, wrap);
+/* d = s>>n */
+static void lcd_bits_shr(uint32_t *d, const uint32_t *s, uint8_t n) {
+    uint8_t w=n>>5, b=n&31;
+    uint8_t i;
+
+    for(i=0;i<LCD_COLWORDS;i++){
+        d[i]=i+w<LCD_COLWORDS ? s[i+w]>>b : 0;
+        if(b && i+w+1<LCD_COLWORDS)
+            d[i]|=s[i+w+1]<<(32-b);
     };
+}
+
+/* n>0 moves the picture up */
+static void lcd_shift_rows(int n, bool wrap) {
+    uint32_t col[LCD_COLWORDS], a[LCD_COLWORDS], b[LCD_COLWORDS];
+    uint8_t up=n>0, x, p, i;
+
+    if(!up)
+        n=-n;
+    if(wrap){
+        n%=RESY;
+        if(n && !up){
+            n=RESY-n;   /* down by n is up by RESY-n */
+            up=1;
+        };
+    }else if(n>RESY)
+        n=RESY;
+    if(!n)
+        return;
 
-    while(y-->0)
-        lcdShiftV(dir, wrap);
+    for(x=0;x<RESX;x++){
+        for(i=0;i<LCD_COLWORDS;i++)
+            col[i]=0;
+        for(p=0;p<RESY_B;p++)
+            col[p>>2]|=(uint32_t)lcdBuffer[p*RESX+x]<<(8*(p&3));
+        if(RESY&31)
+            col[RESY>>5]&=(1UL<<(RESY&31))-1;
+
+        if(up){
+            lcd_bits_shl(a,col,n);
+            if(wrap){
+                lcd_bits_shr(b,col,RESY-n);
+                for(i=0;i<LCD_COLWORDS;i++)
+                    a[i]|=b[i];
+            };
+        }else
+            lcd_bits_shr(a,col,n);
+
+        if(RESY&31)
+            a[RESY>>5]&=(1UL<<(RESY&31))-1;
+        for(p=0;p<RESY_B;p++)
+            lcdBuffer[p*RESX+x]=a[p>>2]>>(8*(p&3));
+    };
 }
 
+void lcdShift(int x, int y, bool wrap) {
+    if(x)
+        lcd_shift_cols(x, wrap);
+    if(y)
+        lcd_shift_rows(y, wrap);
+}
@@ -24,11 +24,41 @@ uint8_t lcdRead(uint8_t data);
 void lcdInit(void);
 void lcdFill(char f);
 void lcdDisplay(void);
+void lcdDisplayPages(uint16_t mask);
+void lcdDoubleBuffer(uint8_t *front);
+void lcdFlip(void);
+void lcdFlipWait(void);
+
+/* Grayscale from bitplanes the app provides and draws into, shown by
+ * temporal dithering on the N1200 (100 to 200 hz work well). */
+void lcdGrayStart(uint8_t *planes, uint8_t bits, uint16_t hz);
+void lcdGrayStop(void);
+void lcdGraySetPixel(int x, int y, uint8_t level);
+uint8_t lcdGrayGetPixel(int x, int y);
+void lcdGrayFill(uint8_t level);
+uint32_t lcd_deadline(uint32_t max);
 void lcdInvert(void);
 void lcdToggleFlag(int flag);
 void lcdSetPixel(char x, char y, bool f);
 //void lcdSafeSetPixel(char x, char y, bool f);  //useless. see in display.c to learn why --the_nihilant
 bool lcdGetPixel(char x, char y);
+
+/* Sprites for lcdBlit() are in the layout of lcdBuffer: width, height,
+ * then (height+7)/8 pages of width bytes, the bottom page first. In a
+ * page the columns run right to left and bit 0 is the lowest row.
+ * tools/image/img2sprite.pl converts images. */
+#define BLIT_OR    0
+#define BLIT_XOR   1
+#define BLIT_CLEAR 2    /* AND NOT */
+void lcdBlit(const uint8_t *sprite, int x, int y, uint8_t mode);
+
+/* Clipped drawing primitives, mode as for lcdBlit(). Spans leave out
+ * their end, lines include both. */
+void lcdHSpan(int x0, int x1, int y, uint8_t mode);
+void lcdVSpan(int x, int y0, int y1, uint8_t mode);
+void lcdLine(int x0, int y0, int x1, int y1, uint8_t mode);
+void lcdRect(int x, int y, int w, int h, uint8_t mode);
+void lcdFillRect(int x, int y, int w, int h, uint8_t mode);
 void lcdShift(int x, int y, bool wrap);
 void lcdSetContrast(int c);
 void lcdSetInvert();
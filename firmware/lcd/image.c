@@ -5,6 +5,8 @@
 #include "lcd/display.h"
 #include "filesystem/ff.h"
 
+#include <string.h>
+
 int lcdLoadImage(char *file) {
     return readFile(file,(char *)lcdBuffer,RESX*RESY_B);
 }
@@ -13,32 +15,159 @@ int lcdSaveImage(char *file) {
 	return writeFile(file,(char *)lcdBuffer,RESX*RESY_B);
 }
 
+/* Animations are either raw frames of RESX*RESY_B bytes back to back,
+ * or (tools/image/img2lcd.pl --anim) delta coded:
+ *
+ *   header: "LCDA", version 1, keyframe interval, frames (u16)
+ *   frame:  size (u16) of the rest after flags, duration in ms (u16,
+ *           0: framems), flags (ANIM_KEY), then a bitmap of the
+ *           ANIM_BLOCKS blocks of 8 bytes of lcdBuffer (page by page,
+ *           bit 0 first) and for the blocks set, their XOR with the last
+ *           frame, run length coded: c<0x80 is followed by c+1 literal
+ *           bytes, c>=0x80 by one byte to repeat c-0x80+3 times.
+ *
+ * A keyframe starts from a blank buffer. The first frame is one, and
+ * playing continues there after the last. Numbers are little endian. */
+#define ANIM_MAGIC   "LCDA"
+#define ANIM_HEADER  8
+#define ANIM_KEY     (1<<0)
+#define ANIM_BLOCKS  (RESY_B*RESX/8)
+
+typedef struct {
+    FIL *file;
+    uint16_t left;          /* of the frame, not read into buf yet */
+    uint8_t pos, len;
+    uint8_t count, repeat, val;
+    uint8_t buf[32];
+} ANIMREAD;
+
+static int anim_getc(ANIMREAD *r){
+    UINT readbytes;
+
+    if(r->pos>=r->len){
+        if(!r->left)
+            return -1;
+        if(f_read(r->file, r->buf, r->left<sizeof(r->buf)?r->left:sizeof(r->buf), &readbytes) || !readbytes)
+            return -1;
+        r->left-=readbytes;
+        r->len=readbytes;
+        r->pos=0;
+    };
+    return r->buf[r->pos++];
+}
+
+static int anim_byte(ANIMREAD *r){
+    int c;
+
+    if(!r->count){
+        if((c=anim_getc(r))<0)
+            return -1;
+        if(c<0x80){
+            r->repeat=0;
+            r->count=c+1;
+        }else{
+            r->repeat=1;
+            r->count=c-0x80+3;
+            if((c=anim_getc(r))<0)
+                return -1;
+            r->val=c;
+        };
+    };
+    r->count--;
+    return r->repeat ? r->val : anim_getc(r);
+}
+
+/* Apply the frame at the file position to lcdBuffer. Returns the pages
+ * that changed, -1 at the end of the file or on errors. */
+static int32_t anim_frame(FIL *file, uint16_t *duration){
+    ANIMREAD r;
+    uint8_t head[5], map[(ANIM_BLOCKS+7)/8], *dst;
+    uint16_t pages=0;
+    UINT readbytes;
+    int c;
+    uint8_t b, i;
+
+    if(f_read(file, head, sizeof(head), &readbytes) || readbytes<sizeof(head))
+        return -1;
+    r.file=file;
+    r.left=head[0] | head[1]<<8;
+    r.pos=r.len=r.count=0;
+    *duration=head[2] | head[3]<<8;
+
+    for(i=0;i<sizeof(map);i++){
+        if((c=anim_getc(&r))<0)
+            return -1;
+        map[i]=c;
+    };
+    if(head[4] & ANIM_KEY){
+        memset(lcdBuffer, 0, RESX*RESY_B);
+        pages=(1<<RESY_B)-1;
+    };
+    for(b=0;b<ANIM_BLOCKS;b++){
+        if(!(map[b>>3] & 1<<(b&7)))
+            continue;
+        dst=lcdBuffer+b*8;
+        for(i=0;i<8;i++){
+            if((c=anim_byte(&r))<0)
+                return -1;
+            dst[i]^=c;
+        };
+        pages|=1<<(b*8/RESX);
+    };
+    if(r.left)
+        f_lseek(file, f_tell(file)+r.left);
+    return pages;
+}
+
 uint8_t lcdShowAnim(char *fname, uint32_t framems) {
     FIL file;            /* File object */
 	int res;
     UINT readbytes;
 	uint8_t state=0;
+    uint8_t head[ANIM_HEADER];
+    uint8_t delta;
+    uint16_t duration=0;
+    int32_t pages;
 
 	res=f_open(&file, fname, FA_OPEN_EXISTING|FA_READ);
 	if(res)
 		return 1;
 
+	delta=!f_read(&file, head, sizeof(head), &readbytes) &&
+		readbytes==sizeof(head) && !memcmp(head, ANIM_MAGIC, 4) && head[4]==1;
+	if(!delta)
+		f_lseek(&file,0);
+
 	getInputWaitRelease();
 	while(!getInputRaw()){
-//        lcdFill(0x55);  // useless, as it will be overwritten anyway by the next instruction  --the_nihilant
-		res = f_read(&file, (char *)lcdBuffer, RESX*RESY_B, &readbytes);
-        if(res)
-            return -1;
-		if(readbytes<RESX*RESY_B){
-			f_lseek(&file,0);
-            continue;
+        if(delta){
+            pages=anim_frame(&file, &duration);
+            if(pages<0){
+                if(f_tell(&file)==ANIM_HEADER)
+                    return -1;
+                f_lseek(&file,ANIM_HEADER);
+                continue;
+            };
+            lcdDisplayPages(pages);
+        }else{
+//          lcdFill(0x55);  // useless, as it will be overwritten anyway by the next instruction  --the_nihilant
+            res = f_read(&file, (char *)lcdBuffer, RESX*RESY_B, &readbytes);
+            if(res)
+                return -1;
+            if(readbytes<RESX*RESY_B){
+                f_lseek(&file,0);
+                continue;
+            };
+            lcdDisplay();
         };
-		lcdDisplay();
-        if(framems<100){
-            state=delayms_queue_plus(framems,0);
+        if(!duration)
+            duration=framems;
+        if(duration<100){
+            state=delayms_queue_plus(duration,0);
         }else{
-            getInputWaitTimeout(framems);
+            getInputWaitTimeout(duration);
         };
+        duration=0;
 	}
 
 	if(state)
@@ -46,5 +175,3 @@ uint8_t lcdShowAnim(char *fname, uint32_t framems) {
 
     return 0;
 };
-
-
@@ -50,6 +50,7 @@
 //#define O_ENABLE_EXTERNAL_FONT  /* needs O_ENABLE_TEXT */
 //#define O_ENABLE_FONT_DUMP      /* dumps font to font path upon first use */
 //#define O_ENABLE_FILE           /* compile file accessing calls */
+//#define O_ENABLE_COMPILE        /* o_compile and o_draw, needs O_ENABLE_RENDER */
 
 #ifdef O_ENABLE_EXTERNAL_FONT
 #ifndef O_ENABLE_FILE
@@ -69,9 +70,26 @@
 #endif
 #endif
 
+#ifdef O_ENABLE_COMPILE
+#ifndef O_ENABLE_RENDER
+#define O_ENABLE_RENDER
+#endif
+#ifndef O_ENABLE_FILL
+#define O_ENABLE_FILL
+#endif
+#endif
+
+#ifdef O_ENABLE_RENDER
+#ifdef O_ENABLE_TRANSFORM
+#ifndef O_ENABLE_TRANSFORM_FUNCS
+#define O_ENABLE_TRANSFORM_FUNCS
+#endif
+#endif
+#endif
+
 
 #define BEZIER_SEGMENTS    16
-#define MAX_SPANS_PER_LINE 7                    /* maximum number of intersecting spans on one line */
+#define MAX_FILL_EDGES     40                   /* edges o_fill keeps on the stack when the o_init buffer is full */
 #define SPP                10                   /* sup pixel precision divider, each pixel is 6 such units internally */
 #define STACK_DEPTH        3                    /* needs O_ENABLE_STACK */
 #define FONT_PATH          "/tmp/font.bin"      /* if O_ENABLE_EXTERNAL_FONT */
@@ -83,6 +101,10 @@ typedef struct _Path    Path;
 typedef struct _Context Context;
 
 #define CLAMP(val,min,max) ((val)<(min)?(min):(val)>(max)?(max):(val))
+#define ABS(val)           ((val)<0?-(val):(val))
+#define MIN(a,b)           ((a)<(b)?(a):(b))
+#define MAX(a,b)           ((a)>(b)?(a):(b))
+#define O_ALIGN(size)      (((size)+sizeof(void*)-1)&~(sizeof(void*)-1))
 
 /* Default color generator shader */
 static int shader_gray (int x, int y, void *data);
@@ -142,6 +164,47 @@ struct _Path
 };
 static Path *path = NULL;
 
+#ifdef O_ENABLE_COMPILE
+typedef struct _Compiled  Compiled;
+typedef struct _Primitive Primitive;
+
+/* the start of an o_compile buffer, the primitives follow it */
+struct _Compiled
+{
+  const signed char *vector_data; /* NULL when compiled from a file */
+#ifdef O_ENABLE_FILE
+  const char        *file_path;
+  int                offset;
+#endif
+#ifdef O_ENABLE_TRANSFORM
+  OMatrix            transform;   /* the primitives are transformed by */
+#endif
+  char              *last;        /* end of the primitives */
+  char              *end;         /* end of the buffer */
+  short int          bounds[4];   /* o_bounds of the program */
+  short int          box[4];      /* pixels touched, x0 y0 x1 y1 */
+  char               failed;      /* did not fit */
+};
+
+/* a pass of a fill, followed by its edges, or a stroke, followed by its
+   nodes */
+struct _Primitive
+{
+#ifdef O_ENABLE_USER_SHADER
+  ShaderFunction shader;
+#endif
+  void          *shader_data;
+  short int      size;       /* bytes to the next primitive */
+  short int      count;      /* edges or nodes */
+  short int      until;      /* sample the pass ends on */
+  short int      box[4];     /* pixels touched, x0 y0 x1 y1 */
+  unsigned char  type;       /* 'f' or 's' */
+  char           line_width;
+};
+
+static Compiled *compiling = NULL;
+#endif
+
 
 /* the actual inner draw function used for doing the real painting */
 static void o_render_span(int x0, int y,
@@ -160,6 +223,16 @@ static void o_render_span(int x0, int y,
 #endif
   if (y <0 || y>=HEIGHT)
     return;
+#if defined(O_ENABLE_BW) && defined(O_ENABLE_USER_SHADER)
+  if (shader == shader_gray)
+    {
+      lcdHSpan (x0, x1, y, shader_gray (x0, y, shader_data) ? BLIT_OR : BLIT_CLEAR);
+      return;
+    }
+#elif defined(O_ENABLE_BW)
+  lcdHSpan (x0, x1, y, shader_gray (x0, y, shader_data) ? BLIT_OR : BLIT_CLEAR);
+  return;
+#endif
   for(int x=x0; x<x1; x++)
     {
 #ifdef O_ENABLE_USER_SHADER
@@ -179,6 +252,43 @@ static Context *context (void)
 #define context() (&path->context)
 #endif
 
+#ifdef O_ENABLE_COMPILE
+/* starts a primitive at the end of the buffer being compiled into */
+static Primitive *compile_prim (unsigned char type)
+{
+  Primitive *prim = (void*)compiling->last;
+
+  if (compiling->failed || (char*)(prim + 1) > compiling->end)
+    {
+      compiling->failed = 1;
+      return NULL;
+    }
+  prim->type = type;
+#ifdef O_ENABLE_USER_SHADER
+  prim->shader = context()->shader;
+#endif
+  prim->shader_data = context()->shader_data;
+#ifdef O_ENABLE_STROKE
+  prim->line_width = context()->line_width;
+#endif
+  return prim;
+}
+
+/* ends a primitive with bytes of data touching the pixels x0,y0 - x1,y1 */
+static void compile_done (Primitive *prim, int bytes,
+                          int x0, int y0, int x1, int y1)
+{
+  short int *box = compiling->box;
+
+  prim->size = O_ALIGN (sizeof (Primitive) + bytes);
+  prim->box[0] = x0; box[0] = MIN (box[0], x0);
+  prim->box[1] = y0; box[1] = MIN (box[1], y0);
+  prim->box[2] = x1; box[2] = MAX (box[2], x1);
+  prim->box[3] = y1; box[3] = MAX (box[3], y1);
+  compiling->last += prim->size;
+}
+#endif
+
 #ifdef O_ENABLE_TRANSFORM
 
 /* copied from twin */
@@ -683,6 +793,36 @@ o_line (int x0, int y0, int x1, int y1, int *need_to_travel, int *traveled_lengt
 }
 
 
+#ifdef O_ENABLE_COMPILE
+/* stores the path, transformed already */
+static void compile_stroke (void)
+{
+  Primitive *prim = compile_prim ('s');
+  int        x0 = 32767, y0 = 32767, x1 = -32768, y1 = -32768;
+  int        bytes = path->count * sizeof (Node);
+  int        r = context()->line_width / 2 + 1;
+
+  if (!prim)
+    return;
+  if ((char*)(prim + 1) + bytes > compiling->end)
+    {
+      compiling->failed = 1;
+      return;
+    }
+  memcpy (prim + 1, path->nodes, bytes);
+  for (int i=0; i<path->count; i++)
+    {
+      x0 = MIN (x0, path->nodes[i].x);
+      y0 = MIN (y0, path->nodes[i].y);
+      x1 = MAX (x1, path->nodes[i].x);
+      y1 = MAX (y1, path->nodes[i].y);
+    }
+  prim->count = path->count;
+  compile_done (prim, bytes, x0 / SPP - r, y0 / SPP - r,
+                             x1 / SPP + r, y1 / SPP + r);
+}
+#endif
+
 void
 o_stroke (void)
 {
@@ -692,6 +832,14 @@ o_stroke (void)
   int   x = 0, y = 0;
   int   i = 0;
 
+#ifdef O_ENABLE_COMPILE
+  if (compiling)
+    {
+      compile_stroke ();
+      return;
+    }
+#endif
+
   i=0;
   while (i < path->count)
     {
@@ -733,151 +881,384 @@ o_stroke (void)
 
 #ifdef O_ENABLE_FILL
 
-#define EMPTY_SCAN_SLOT -126
+/* o_fill keeps the edges of the flattened path in the part of the o_init
+ * buffer that the path leaves unused, or on the stack if that is smaller,
+ * sorted by the first scanline they cross. Walking down the scanlines,
+ * the active edges edges[a..b) are stepped in fixed point and kept sorted
+ * by x, every pair of them is one span. When not all edges fit, the ones
+ * starting lowest are left out and the rows below them are done in
+ * another pass over the path. Scanlines are sampled at their centers,
+ * with O_FILL_SUBSAMPLES samples per pixel row when there are gray levels
+ * to spend the coverage on.
+ */
+#if defined(O_ENABLE_GRAY) || defined(O_ENABLE_GRAY_EXTRA)
+#define O_FILL_SUBSAMPLES  4
+#else
+#define O_FILL_SUBSAMPLES  1
+#endif
 
-/* insertion sort integer into array */
-static void insert_sorted (signed char *array, int value)
+typedef struct _Edge Edge;
+struct _Edge
 {
-  for (int j=0; j<MAX_SPANS_PER_LINE; j++)
+  int       x;      /* 16.16 pixels, at the current sample */
+  int       dxdy;   /* 16.16 pixels per sample */
+  short int i0;     /* first sample */
+  short int i1;     /* sample after the last one */
+};
+
+static Edge *edges;
+static int   edge_count;
+static int   edge_max;
+static int   edge_from;   /* samples of this pass */
+static int   edge_until;
+static char  edge_dropped; /* edges were left to the next pass */
+
+/* the first sample at or below y (in SPP units), sample i is centered at
+ * (2i+1) * SPP / (2 * O_FILL_SUBSAMPLES)
+ */
+static int sample_below (int y)
+{
+  int n = 2 * O_FILL_SUBSAMPLES * y + SPP - 1;
+  return n >= 0 ? n / (2 * SPP) : -((2 * SPP - 1 - n) / (2 * SPP));
+}
+
+static void add_edge (int x0, int y0, int x1, int y1)
+{
+  Edge  e;
+  int   i0, i1, dx, dy, q, off;
+
+  if (y0 > y1)
     {
-      if (array[j] == EMPTY_SCAN_SLOT)
+      int t;
+      t = x0; x0 = x1; x1 = t;
+      t = y0; y0 = y1; y1 = t;
+    }
+  i0 = sample_below (y0);
+  i1 = sample_below (y1);
+  if (i0 < edge_from)
+    i0 = edge_from;
+  if (i1 > HEIGHT * O_FILL_SUBSAMPLES)
+    i1 = HEIGHT * O_FILL_SUBSAMPLES;
+  if (i0 >= i1 || i0 >= edge_until)
+    return;
+
+  e.i0 = i0;
+  e.i1 = i1;
+
+  /* (dx << 16) / dy without overflowing, dx is up to 16 bits */
+  dx = x1 - x0;
+  dy = (y1 - y0) * O_FILL_SUBSAMPLES;
+  q  = (dx << 15) / dy;
+  e.dxdy = q * 2 + ((dx << 15) - q * dy) * 2 / dy;
+
+  /* step from y0 to the center of sample i0, off / (2 * SPP) samples */
+  off = (2 * i0 + 1) * SPP - 2 * O_FILL_SUBSAMPLES * y0;
+  e.x = (x0 << 15) / SPP * 2 +
+        e.dxdy / (2 * SPP) * off + e.dxdy % (2 * SPP) * off / (2 * SPP);
+
+  if (edge_count == edge_max)
+    { /* make room by leaving the lowest edge to the next pass */
+      int last = 0;
+      for (int i=1; i<edge_count; i++)
+        if (edges[i].i0 > edges[last].i0)
+          last = i;
+      edge_dropped = 1;
+      if (edges[last].i0 <= i0)
         {
-          array[j] = value;
+          edge_until = i0;
           return;
         }
-      if (array[j] > value)
+      edge_until = edges[last].i0;
+      edges[last] = e;
+      return;
+    }
+  edges[edge_count++] = e;
+}
+
+/* flattens the path into edges, closing every subpath */
+static void add_path (void)
+{
+  Node *iter;
+  int   prev_x,  prev_y;
+  int   first_x, first_y;
+
+  first_x = prev_x = path->nodes[0].x;
+  first_y = prev_y = path->nodes[0].y;
+  iter = &path->nodes[1];
+  for (int i=1; i<path->count; i++, iter++)
+    {
+      switch (iter->type)
         {
-          for (int k=MAX_SPANS_PER_LINE -1; k >= j+1; k--)
-            array[k] = array[k-1];
-          array[j] = value;
-          return;
+          case 'm':
+            add_edge (prev_x, prev_y, first_x, first_y);
+            first_x = iter->x;
+            first_y = iter->y;
+            break;
+          case 'l':
+            add_edge (prev_x, prev_y, iter->x, iter->y);
+            break;
+          case 'C':
+            { /* piecewise linear, with enough segments to stay within
+                 about an eighth of a pixel of the curve */
+              Node *pts[4];
+              int   n = 1, d = 0;
+
+              for (int j=0; j<4; j++)
+                pts[j] = &iter[j-3];
+              for (int j=0; j<2; j++)
+                {
+                  int dd = ABS (pts[j]->x - 2 * pts[j+1]->x + pts[j+2]->x) +
+                           ABS (pts[j]->y - 2 * pts[j+1]->y + pts[j+2]->y);
+                  if (d < dd)
+                    d = dd;
+                }
+              while (n < BEZIER_SEGMENTS && n * n * SPP < 3 * d)
+                n++;
+              for (int j=1; j<=n; j++)
+                {
+                  Node iter2;
+                  bezier (pts, &iter2, j * FIXED_ONE / n);
+                  add_edge (prev_x, prev_y, iter2.x, iter2.y);
+                  prev_x = iter2.x;
+                  prev_y = iter2.y;
+                }
+              break;
+            }
+          default:
+            continue;
         }
+      prev_x = iter->x;
+      prev_y = iter->y;
     }
+  add_edge (prev_x, prev_y, first_x, first_y);
 }
 
-static void fill_line (int prev_x, int prev_y, int dest_x, int dest_y,
-                       signed char scanlines[HEIGHT][MAX_SPANS_PER_LINE],
-                       int *lastdir, int *lastline)
+#if O_FILL_SUBSAMPLES > 1
+/* paints pixel row y from the number of samples covering each pixel,
+ * partly covered pixels are masked with the dither of their coverage
+ */
+static void fill_coverage (int y, unsigned char *coverage)
 {
-  int ydir;
-  int dx, dy;
-  dx = dest_x - prev_x;
-  dy = dest_y - prev_y;
-
-  ydir = (dy < 0) ? -1 : 1;
+  for (int x = 0; x < WIDTH; x++)
+    {
+      int x1 = x;
+
+      while (x1 < WIDTH && coverage[x1] == O_FILL_SUBSAMPLES)
+        x1++;
+      if (x1 == x && coverage[x] &&
+          shader_gray (x, y, (void*)(coverage[x] * GRAY_PRECISION / O_FILL_SUBSAMPLES)))
+        x1++;
+      if (x1 > x)
+        {
+          o_render_span (x, y, x1,
+#ifdef O_ENABLE_USER_SHADER
+                         context()->shader,
+#endif
+                         context()->shader_data);
+          x = x1 - 1;
+        }
+    }
+  memset (coverage, 0, WIDTH);
+}
+#endif
 
-  /* do linear interpolation between vertexes */
-  for (int y = prev_y; y != dest_y; y += ydir)
-    if (y >= 0 && y < HEIGHT && *lastline != y)
+/* collects the edges of the path for the pass starting at edge_from,
+ * sorted by first sample
+ */
+static void collect_edges (void)
+{
+  int h;
+
+  edge_until = HEIGHT * O_FILL_SUBSAMPLES;
+  edge_count = 0;
+  edge_dropped = 0;
+  add_path ();
+  /* passes end on pixel rows, and make progress even if the edges
+     starting on one row do not fit */
+  edge_until -= edge_until % O_FILL_SUBSAMPLES;
+  if (edge_until <= edge_from)
+    edge_until = edge_from + O_FILL_SUBSAMPLES;
+
+  /* shell sort, subpaths going up arrive backwards */
+  for (h = 1; h < edge_count / 3; h = h * 3 + 1);
+  for (; h > 0; h /= 3)
+    for (int i=h; i<edge_count; i++)
       {
-        int x = prev_x + (dx * (y-prev_y)) / dy;
-        insert_sorted(&scanlines[y][0], x);
-        if (ydir != *lastdir) // && *lastdir != -2)  //XXX: ugly optimizing hack
-          insert_sorted(&scanlines[y][0], x);
-
-        *lastdir = ydir;
-        *lastline = y;
+        Edge e = edges[i];
+        int  j;
+        for (j=i; j>=h && edges[j-h].i0 > e.i0; j-=h)
+          edges[j] = edges[j-h];
+        edges[j] = e;
       }
 }
 
-void o_fill (void)
+/* paints the sorted edges down to edge_until */
+static void scan_edges (void)
 {
-  if (path->count < 1)
+  int a, b, s;
+#if O_FILL_SUBSAMPLES > 1
+  unsigned char coverage[WIDTH];
+
+  memset (coverage, 0, WIDTH);
+#endif
+
+  if (!edge_count)
     return;
+  a = b = 0;
+  s = edges[0].i0;
+  while (s < edge_until)
+    {
+      /* retire the edges that ended, and skip ahead if none are left */
+      for (int i=a; i<b; i++)
+        if (edges[i].i1 <= s)
+          {
+            Edge e = edges[i];
+            edges[i] = edges[a];
+            edges[a++] = e;
+          }
+      if (a == b)
+        {
+          if (b == edge_count || edges[b].i0 >= edge_until)
+            break;
+#if O_FILL_SUBSAMPLES > 1
+          if (s % O_FILL_SUBSAMPLES &&
+              edges[b].i0 / O_FILL_SUBSAMPLES != s / O_FILL_SUBSAMPLES)
+            fill_coverage (s / O_FILL_SUBSAMPLES, coverage);
+#endif
+          s = edges[b].i0;
+        }
+      /* activate the edges starting here */
+      while (b < edge_count && edges[b].i0 <= s)
+        b++;
 
-  {
-    signed char scanlines[HEIGHT][MAX_SPANS_PER_LINE];
-    /* Stack allocated scanline intersection list  */
-    Node *iter;
-    int   prev_x,  prev_y;
-    int   first_x, first_y;
-    int   lastline = -1;
-    int   lastdir  = -2;
+      /* keep them sorted by x, mostly they already are */
+      for (int i=a+1; i<b; i++)
+        {
+          Edge e = edges[i];
+          int  j;
+          for (j=i; j>a && edges[j-1].x > e.x; j--)
+            edges[j] = edges[j-1];
+          edges[j] = e;
+        }
 
-    for (int i = 0; i<HEIGHT; i++)
-      for (int j=0; j<MAX_SPANS_PER_LINE; j++)
-        scanlines[i][j] = EMPTY_SCAN_SLOT;
+      for (int i=a; i+1<b; i+=2)
+        {
+          /* the pixels with their centers inside */
+          int x0 = (edges[i].x   + 0x7fff) >> 16;
+          int x1 = (edges[i+1].x + 0x7fff) >> 16;
+          if (x0 >= x1)
+            continue;
+#if O_FILL_SUBSAMPLES > 1
+          x0 = CLAMP (x0, 0, WIDTH);
+          x1 = CLAMP (x1, 0, WIDTH);
+          while (x0 < x1)
+            coverage[x0++]++;
+#else
+          o_render_span (x0, s, x1,
+#ifdef O_ENABLE_USER_SHADER
+                         context()->shader,
+#endif
+                         context()->shader_data);
+#endif
+        }
 
-    first_x = prev_x = path->nodes[0].x / SPP;
-    first_y = prev_y = path->nodes[0].y / SPP;
+      for (int i=a; i<b; i++)
+        edges[i].x += edges[i].dxdy;
+      s++;
+#if O_FILL_SUBSAMPLES > 1
+      if (s % O_FILL_SUBSAMPLES == 0)
+        fill_coverage (s / O_FILL_SUBSAMPLES - 1, coverage);
+#endif
+    }
+#if O_FILL_SUBSAMPLES > 1
+  if (s % O_FILL_SUBSAMPLES)
+    fill_coverage (s / O_FILL_SUBSAMPLES, coverage);
+#endif
+}
 
-    /* saturate scanline intersection list */
-    iter = &path->nodes[1];
-    for (int i=1; i<path->count; i++, iter++)
-      {
-        switch (iter->type)
-          {
-            int dest_x;
-            int dest_y;
-            case 'm':
-              {
-                first_x = prev_x = iter->x / SPP;
-                first_y = prev_y = iter->y / SPP;
-                break;
-              }
-            case 'l':
-              {
-                dest_x = iter->x / SPP;
-                dest_y = iter->y / SPP;
-fill_close:  /* label used for goto to close last segment */
+/* room for edges after the first n nodes of the o_init buffer */
+static Edge *edge_room (int n, int *max)
+{
+  Edge *room = (void*)(((unsigned long)&path->nodes[n] + 3) & ~3UL);
 
-                fill_line (prev_x, prev_y, dest_x, dest_y, scanlines, &lastdir, &lastline);
-
-                prev_x = dest_x;
-                prev_y = dest_y;
-                /* if we're on the last knot, fake the first vertex being a next one */
-                if (i+1 == path->count)
-                  {
-                    dest_x = first_x;
-                    dest_y = first_y;
-                    i++; /* to make the loop finally end */
-                    goto fill_close;
-                  }
-                break;
-              }
-          case 'C':
-            { /* create piecevize linear approximation of bezier curve */
-               int   i;
-               Node *pts[4];
+  *max = ((char*)&path->nodes[path->max_size] - (char*)room) / (int)sizeof (Edge);
+  return room;
+}
 
-               for (i=0;i<4;i++)
-                   pts[i]=&iter[i-3];
-               for (i=0; i< FIXED_ONE; i+= FIXED_ONE/ BEZIER_SEGMENTS)
-                 {
-                    Node iter2;
-                    bezier (pts, &iter2, i);
-                    fill_line (prev_x, prev_y, iter2.x/SPP, iter2.y/SPP, scanlines, &lastdir, &lastline);
-                    prev_x = iter2.x / SPP;
-                    prev_y = iter2.y / SPP;
-                 }
-               if (i+1 == path->count)
-                 {
-                   dest_x = first_x;
-                   dest_y = first_y;
-                   i++; /* to make the loop finally end */
-                   goto fill_close;
-                 }
-               break;
-            }
-          }
-      }
+#ifdef O_ENABLE_COMPILE
+/* stores the edges of each pass as a primitive, they are drawn from
+ * the buffer o_draw has for them, so passes are not made larger than
+ * that
+ */
+static void compile_fill (void)
+{
+  int room;
 
-    /* Fill the spans */
-    for (int i=0; i < HEIGHT; i++)
-      {
-        for (int j=0; j<MAX_SPANS_PER_LINE-2; j+=2)
-          {
-            if (scanlines[i][j] > EMPTY_SCAN_SLOT)
-              {
-                o_render_span (scanlines[i][j], i, scanlines[i][j+1],
-#ifdef O_ENABLE_USER_SHADER
-                      context()->shader,
+  edge_room (0, &room);
+  if (room < MAX_FILL_EDGES)
+    room = MAX_FILL_EDGES;
+  for (edge_from = 0; edge_from < HEIGHT * O_FILL_SUBSAMPLES; edge_from = edge_until)
+    {
+      Primitive *prim = compile_prim ('f');
+      int        x0 = 0x7fffffff, x1 = -0x7fffffff, i1 = 0;
+
+      if (!prim)
+        return;
+      edges = (void*)(prim + 1);
+      edge_max = (compiling->end - (char*)edges) / (int)sizeof (Edge);
+      if (edge_max > room)
+        edge_max = room;
+      collect_edges ();
+      if (edge_dropped && edge_max < room)
+        {
+          compiling->failed = 1;
+          return;
+        }
+      if (!edge_count)
+        continue;
+
+      for (int i=0; i<edge_count; i++)
+        {
+          int xe = edges[i].x + edges[i].dxdy * (edges[i].i1 - edges[i].i0 - 1);
+          x0 = MIN (x0, MIN (edges[i].x, xe));
+          x1 = MAX (x1, MAX (edges[i].x, xe));
+          i1 = MAX (i1, edges[i].i1);
+        }
+      prim->count = edge_count;
+      prim->until = edge_until;
+      compile_done (prim, edge_count * sizeof (Edge),
+                    x0 >> 16, edges[0].i0 / O_FILL_SUBSAMPLES,
+                    (x1 >> 16) + 1, (i1 + O_FILL_SUBSAMPLES - 1) / O_FILL_SUBSAMPLES);
+    }
+}
 #endif
-                      context()->shader_data);
-              }
-          }
-      }
-  }
+
+void o_fill (void)
+{
+  Edge  stack_edges[MAX_FILL_EDGES];
+
+  if (path->count < 1)
+    return;
+#ifdef O_ENABLE_COMPILE
+  if (compiling)
+    {
+      compile_fill ();
+      return;
+    }
+#endif
+
+  edges = edge_room (path->count, &edge_max);
+  if (edge_max < MAX_FILL_EDGES)
+    {
+      edges = stack_edges;
+      edge_max = MAX_FILL_EDGES;
+    }
+
+  for (edge_from = 0; edge_from < HEIGHT * O_FILL_SUBSAMPLES; edge_from = edge_until)
+    {
+      collect_edges ();
+      scan_edges ();
+    }
 }
 
 #endif
@@ -1007,8 +1388,12 @@ static const signed char * _o_process_op (const signed char *g)
     case 'c': o_curve_to (g[0], g[1], g[2], g[3], g[4], g[5]); g += 6; break;
     case 'z': o_close (); break;
 
+#ifdef O_ENABLE_STROKE
               /* directly in px XXX: should be 10 = 1.0 instead? */
     case 'w': o_set_line_width (g[0]); g ++; break;
+#else
+    case 'w': g ++; break;
+#endif
               /* 0 = black, 50 = gray, 100 = white */
     case 'g': o_set_gray (g[0]*10); g ++; break;
 
@@ -1017,6 +1402,8 @@ static const signed char * _o_process_op (const signed char *g)
 #endif
 #ifdef O_ENABLE_STROKE
     case 's': o_stroke (); break;
+#else
+    case 's': break;
 #endif
 
 #ifdef O_ENABLE_FLUFF_CODE
@@ -1225,6 +1612,195 @@ o_bounds_file (const char *file_path,
 }
 #endif
 
+#ifdef O_ENABLE_COMPILE
+
+/* whether the pixels in box are outside the screen, or the clip */
+static int o_culled (const short int *box)
+{
+  int y0 = MAX (box[1], 0);
+  int y1 = MIN (box[3], HEIGHT);
+
+  if (box[2] <= 0 || box[0] >= WIDTH || y0 >= y1)
+    return 1;
+#ifdef O_ENABLE_CLIP
+  for (int y = y0; y < y1; y++)
+    if (path->clip.row[y][0] < box[2] && path->clip.row[y][1] > box[0])
+      return 0;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/* runs the program with o_fill and o_stroke storing primitives instead of
+ * drawing, under the current transform. Leaves the state as it was.
+ */
+static int o_recompile (Compiled *c)
+{
+#ifdef O_ENABLE_TRANSFORM
+  OMatrix        transform   = context()->transform;
+#endif
+#ifdef O_ENABLE_USER_SHADER
+  ShaderFunction shader      = context()->shader;
+#endif
+  void          *shader_data = context()->shader_data;
+#ifdef O_ENABLE_STROKE
+  char           line_width  = context()->line_width;
+#endif
+
+#ifdef O_ENABLE_TRANSFORM
+  c->transform = transform;
+#endif
+  c->last   = (char*)(c + 1);
+  c->failed = 0;
+  c->box[0] = c->box[1] = 32767;
+  c->box[2] = c->box[3] = -32768;
+
+  compiling = c;
+  o_path_new ();
+#ifdef O_ENABLE_FILE
+  if (!c->vector_data)
+    o_render_file (c->file_path, c->offset);
+  else
+#endif
+    o_render (c->vector_data);
+  o_path_new ();
+  compiling = NULL;
+
+#ifdef O_ENABLE_TRANSFORM
+  context()->transform   = transform;
+#endif
+#ifdef O_ENABLE_USER_SHADER
+  context()->shader      = shader;
+#endif
+  context()->shader_data = shader_data;
+#ifdef O_ENABLE_STROKE
+  context()->line_width  = line_width;
+#endif
+  return c->failed ? 0 : c->last - (char*)c;
+}
+
+static Compiled *o_compiled (void *buf, int buf_size)
+{
+  Compiled *c = buf;
+
+  if (buf_size < (int)sizeof (Compiled))
+    return NULL;
+  c->end = (char*)buf + (buf_size & ~(sizeof (void*) - 1));
+  return c;
+}
+
+int o_compile (void       *buf,
+               int         buf_size,
+               const signed char *vector_data)
+{
+  Compiled *c = o_compiled (buf, buf_size);
+  int       minx, miny, maxx, maxy;
+
+  if (!c)
+    return 0;
+  c->vector_data = vector_data;
+  o_bounds (vector_data, &minx, &miny, &maxx, &maxy);
+  c->bounds[0] = minx; c->bounds[1] = miny;
+  c->bounds[2] = maxx; c->bounds[3] = maxy;
+  return o_recompile (c);
+}
+
+#ifdef O_ENABLE_FILE
+int o_compile_file (void       *buf,
+                    int         buf_size,
+                    const char *file_path,
+                    int         offset)
+{
+  Compiled *c = o_compiled (buf, buf_size);
+  int       minx, miny, maxx, maxy;
+
+  if (!c)
+    return 0;
+  c->vector_data = NULL;
+  c->file_path   = file_path;
+  c->offset      = offset;
+  o_bounds_file (file_path, offset, &minx, &miny, &maxx, &maxy);
+  c->bounds[0] = minx; c->bounds[1] = miny;
+  c->bounds[2] = maxx; c->bounds[3] = maxy;
+  return o_recompile (c);
+}
+#endif
+
+void o_bounds_compiled (const void *buf,
+                        int *minx, int *miny,
+                        int *maxx, int *maxy)
+{
+  const Compiled *c = buf;
+
+  if (minx) *minx = c->bounds[0];
+  if (miny) *miny = c->bounds[1];
+  if (maxx) *maxx = c->bounds[2];
+  if (maxy) *maxy = c->bounds[3];
+}
+
+void o_draw (void *buf)
+{
+  Compiled  *c = buf;
+  Primitive *prim;
+  Edge       stack_edges[MAX_FILL_EDGES];
+  Edge      *room;
+  int        max;
+
+#ifdef O_ENABLE_TRANSFORM
+  if (memcmp (&c->transform, &context()->transform, sizeof (OMatrix)))
+    o_recompile (c);
+#endif
+  if (c->failed)
+    { /* did not fit, draw it the slow way */
+#ifdef O_ENABLE_FILE
+      if (!c->vector_data)
+        {
+          o_render_file (c->file_path, c->offset);
+          return;
+        }
+#endif
+      o_render (c->vector_data);
+      return;
+    }
+  if (o_culled (c->box))
+    return;
+
+  o_path_new ();
+  room = edge_room (0, &max);
+  if (max < MAX_FILL_EDGES)
+    room = stack_edges;
+  for (prim = (void*)(c + 1); (char*)prim < c->last;
+       prim = (void*)((char*)prim + prim->size))
+    {
+#ifdef O_ENABLE_USER_SHADER
+      context()->shader = prim->shader;
+#endif
+      context()->shader_data = prim->shader_data;
+      if (o_culled (prim->box))
+        continue;
+      if (prim->type == 'f')
+        {
+          edges      = room;
+          edge_count = prim->count;
+          edge_until = prim->until;
+          memcpy (edges, prim + 1, edge_count * sizeof (Edge));
+          scan_edges ();
+        }
+#ifdef O_ENABLE_STROKE
+      else
+        {
+          context()->line_width = prim->line_width;
+          memcpy (path->nodes, prim + 1, prim->count * sizeof (Node));
+          path->count = prim->count;
+          o_stroke ();
+          path->count = 0;
+        }
+#endif
+    }
+}
+#endif
+
 #endif
 
 /******************************************************************************/
@@ -22,6 +22,10 @@
 /* initialize o with a given work data buffer, and the size of the data buffer
    in bytes. This data buffer should be allocated on the stack (char buf[2048];
    o_init (buf, sizeof (buf));
+   o_fill () keeps the edges of the path in the part of the buffer the path
+   does not use, 12 bytes per straight edge, or 40 of them on the stack when
+   that is more. If they do not all fit it takes several passes, only edges
+   beyond that number crossing the same row are lost.
  */
 void o_init (void *data, int data_size);
 
@@ -97,6 +101,25 @@ int  o_file_offset    (const char *file_path, int no);
 /* renders the sprite starting at the given offset in a file */
 void o_render_file    (const char *file_path, int offset);
 
+/*** compiled programs ***/
+
+/* compiles a program under the current transform into buf, which has to be
+   kept around for o_draw. Fills are stored as edges ready to be scanned and
+   strokes as transformed nodes, together with the pixels they touch.
+   Returns the number of bytes used, 0 if buf was too small; o_draw then
+   falls back to o_render. Transforms and colors set by the program do not
+   last beyond it, clipping inside it is not recorded.
+ */
+int  o_compile        (void *buf, int buf_size, const signed char *vector_data);
+/* the same for a program in a file, file_path has to stay valid */
+int  o_compile_file   (void *buf, int buf_size, const char *file_path, int offset);
+/* draws a compiled program, skipping what is outside the screen and the
+   clip, it is compiled again first when the transform changed. Clears the
+   current path. */
+void o_draw           (void *buf);
+/* the o_bounds of a compiled program */
+void o_bounds_compiled (const void *buf, int *minx, int *miny, int *maxx, int *maxy);
+
 /*** clipping ***/
 void o_clip           (void);
 void o_reset_clip     (void);
@@ -17,12 +17,17 @@ struct EXTFONT efont;
 
 static FIL file; /* current font file */
 
+/* Identifies the font for the text cache: the font table, or the name
+ * and size of the font file */
+static uint32_t font_key;
+
 /* Exported Functions */
 
 void setIntFont(const struct FONT_DEF * newfont){
     memcpy(&efont.def,newfont,sizeof(struct FONT_DEF));
     efont.type=FONT_INTERNAL;
     font=&efont.def;
+    font_key=(uint32_t)(uintptr_t)font->au8FontTable;
 };
 
 void setExtFont(const char *fname){
@@ -179,33 +184,43 @@ static int _getIndex(int c){
 
 uint8_t charBuf[MAXCHR];
 
-int DoChar(int sx, int sy, int c){
+static uint32_t font_hash(const char *s, uint32_t h){
+    while(*s)
+        h=(h^(uint8_t)*s++)*16777619;
+    return h;
+};
 
-//    font=NULL;
-    if(font==NULL){
-        if(efont.type==FONT_INTERNAL){
-            font=&efont.def;
-        }else if (efont.type==FONT_EXTERNAL){
-            UINT res;
-            res=f_open(&file, efont.name, FA_OPEN_EXISTING|FA_READ);
-            if(res){
-                efont.type=0;
-                font=&Font_7x8;
-            }else{
-                _getFontData(START_FONT,0);
-                font=&efont.def;
-            };
-        }else{
+static void font_init(void){
+    if(font!=NULL)
+        return;
+    if(efont.type==FONT_INTERNAL){
+        font=&efont.def;
+    }else if (efont.type==FONT_EXTERNAL){
+        UINT res;
+        res=f_open(&file, efont.name, FA_OPEN_EXISTING|FA_READ);
+        if(res){
+            efont.type=0;
             font=&Font_7x8;
+        }else{
+            _getFontData(START_FONT,0);
+            font=&efont.def;
+            font_key=font_hash(efont.name,2166136261u)^file.fsize;
+            return;
         };
+    }else{
+        font=&Font_7x8;
     };
+    font_key=(uint32_t)(uintptr_t)font->au8FontTable;
+};
 
-	/* how many bytes is it high? */
+/* Look up character c: its columns (height bytes each, valid until the
+ * next call), the blank columns before and after them. Returns the
+ * number of columns with data, -1 if the font file fails. */
+static int _getGlyph(int c, const uint8_t **glyph, int *pre, int *post){
 	char height=(font->u8Height-1)/8+1;
-    char hoff=(8-(font->u8Height%8))%8;
-
 	const uint8_t * data;
     int width,preblank=0,postblank=0; 
+
     do { /* Get Character data */
         /* Get intex into character list */
         c=_getIndex(c);
@@ -227,7 +242,7 @@ int DoChar(int sx, int sy, int c){
                 if(size > MAXCHR) size = MAXCHR;
                 res = f_read(&file, charBuf, size, &readbytes);
                 if(res != FR_OK || readbytes<width*height)
-                    return sx;
+                    return -1;
                 data=charBuf;
             }else{
                 for(int y=0;y<c;y++)
@@ -258,7 +273,7 @@ int DoChar(int sx, int sy, int c){
                     if(size > MAXCHR) size = MAXCHR;
                     res = f_read(&file, charBuf, size, &readbytes);
                     if(res != FR_OK || readbytes<width*height)
-                        return sx;
+                        return -1;
                     data=charBuf;
                 }else{
                     _getFontData(SEEK_DATA,toff);
@@ -287,6 +302,19 @@ int DoChar(int sx, int sy, int c){
 
     }while(0);
 
+    *glyph=data;
+    *pre=preblank;
+    *post=postblank;
+    return width;
+};
+
+/* Draw width columns of the current font at sx, blank ones if data is
+ * NULL. The font's rows are cleared, the rest stays. */
+static void _drawColumns(int sx, int sy, const uint8_t *data, int width){
+	/* how many bytes is it high? */
+	char height=(font->u8Height-1)/8+1;
+    char hoff=(8-(font->u8Height%8))%8;
+
 	/* "real" coordinates. Our physical display is upside down */
 #define xy_(x,yb) ( ( (RESY_B-1) -(yb)) * RESX + \
                     ( (RESX-1)   -( x)) )
@@ -297,6 +325,9 @@ int DoChar(int sx, int sy, int c){
 	int byte;
 	unsigned char mask;
 
+    if(width<=0 || sx>=RESX || sx+width<=0)
+        return;
+
     /* Our display height is non-integer. Adjust for that. */
     sy+=RESY%8;
 
@@ -312,8 +343,6 @@ int DoChar(int sx, int sy, int c){
         yidx-=1;
     };
 
-    sx+=preblank;
-
 	/* multiple 8-bit-lines */
 	for(int y=0;y<=height;y++){
         if(yidx+y<0)
@@ -341,45 +370,49 @@ int DoChar(int sx, int sy, int c){
 
         flip(mask);
 
-        /* Optional: empty space to the left */
-		for(int b=1;b<=preblank;b++){
-            if(sx-b<0)
-                continue;
-            if(sx-b>=RESX)
-                continue;
-			lcdBuffer[xy_(sx-b,yidx+y)]&=~mask;
-		};
-        /* Render character */
 		for(x=0;x<width;x++){
-			unsigned char b1,b2;
-			if(y==0)
-				b1=0;
-			else
-				b1=data[x*height+(height-1)-(y-1)];
-			if(y==height)
-				b2=0;
-			else
-				b2=data[x*height+(height-1)-(y)];
-
-			byte= (b1>>(8-yoff)) | (b2<<yoff);
-            flip(byte);
-
             if(sx+x<0)
                 continue;
             if(sx+x>=RESX)
-                continue;
+                break;
+            if(data){
+                unsigned char b1,b2;
+                if(y==0)
+                    b1=0;
+                else
+                    b1=data[x*height+(height-1)-(y-1)];
+                if(y==height)
+                    b2=0;
+                else
+                    b2=data[x*height+(height-1)-(y)];
+
+                byte= (b1>>(8-yoff)) | (b2<<yoff);
+                flip(byte);
+            }else
+                byte=0;
+
 			lcdBuffer[xy_(sx+x,yidx+y)]&=~mask;
 			lcdBuffer[xy_(sx+x,yidx+y)]|=byte;
 		};
-        /* Optional: empty space to the right */
-		for(int m=0;m<postblank;m++){
-            if(sx+x+m<0)
-                continue;
-            if(sx+x+m>=RESX)
-                continue;
-			lcdBuffer[xy_(sx+x+m,yidx+y)]&=~mask;
-		};
 	};
+};
+
+int DoChar(int sx, int sy, int c){
+	const uint8_t * data;
+    int width,preblank,postblank;
+
+    font_init();
+    width=_getGlyph(c,&data,&preblank,&postblank);
+    if(width<0)
+        return sx;
+
+    /* Optional: empty space to the left */
+    _drawColumns(sx,sy,NULL,preblank);
+    sx+=preblank;
+    /* Render character */
+    _drawColumns(sx,sy,data,width);
+    /* Optional: empty space to the right */
+    _drawColumns(sx+width,sy,NULL,postblank);
 	return sx+(width+postblank);
 };
 
@@ -388,25 +421,188 @@ int DoChar(int sx, int sy, int c){
 #define UT2(a)   ( ((a[0]&31)<<6)  + (a[1]&63) )
 #define UT3(a)   ( ((a[0]&15)<<12) + ((a[1]&63)<<6) + (a[2]&63) )
 
+/* The character at *c, advancing *c past it */
+static int _nextChar(const char **c){
+    const char *s=*c;
+    int uc;
+
+#ifdef UTF8
+    /* will b0rk on non-utf8 */
+    if((*s&(128+64+32))==(128+64) && s[1]!=0){
+        uc=UT2(s); s+=2;
+    }else if( (*s&(128+64+32+16))==(128+64+32) && s[1]!=0 && s[2] !=0){
+        uc=UT3(s); s+=3;
+    }else
+#endif
+        uc=*s++;
+    *c=s;
+    return uc;
+};
+
+/* Text cache: strings drawn (or measured) recently, as the columns
+ * DoChar() would draw, so drawing one again is a single pass of
+ * _drawColumns() without looking up any character. Runs are keyed by
+ * font and string, kept back to back in tc_pool in the order they were
+ * made and thrown out least recently used first. */
+#if CFG_TEXTCACHE
+#define TC_RUNS 8
+
+typedef struct {
+    uint32_t font;
+    uint16_t off;           /* into tc_pool: the string, then the columns */
+    uint16_t size;
+    uint16_t width;
+    uint16_t used;
+    uint8_t len;
+} TCRUN;
+
+static TCRUN tc_run[TC_RUNS];
+static uint8_t tc_runs;
+static uint16_t tc_free, tc_end;    /* end of the runs, of the one in making */
+static uint16_t tc_clock;
+static uint8_t tc_pool[CFG_TEXTCACHE];
+
+static TCRUN *tc_find(const char *s, uint8_t len){
+    uint8_t i;
+
+    for(i=0;i<tc_runs;i++)
+        if(tc_run[i].font==font_key && tc_run[i].len==len &&
+                !memcmp(tc_pool+tc_run[i].off,s,len)){
+            tc_run[i].used=++tc_clock;
+            return &tc_run[i];
+        };
+    return NULL;
+};
+
+/* Throw out the least recently used run, moving the ones after it (and
+ * the one in making) down */
+static uint8_t tc_evict(void){
+    uint8_t i, lru=0;
+    uint16_t size;
+
+    if(!tc_runs)
+        return 0;
+    for(i=1;i<tc_runs;i++)
+        if((uint16_t)(tc_clock-tc_run[i].used)>(uint16_t)(tc_clock-tc_run[lru].used))
+            lru=i;
+    size=tc_run[lru].size;
+    memmove(tc_pool+tc_run[lru].off,tc_pool+tc_run[lru].off+size,
+            tc_end-tc_run[lru].off-size);
+    for(i=lru;i+1<tc_runs;i++){
+        tc_run[i]=tc_run[i+1];
+        tc_run[i].off-=size;
+    };
+    tc_runs--;
+    tc_free-=size;
+    tc_end-=size;
+    return 1;
+};
+
+/* Lay out the run for s at tc_free as far as it fits in the pool and
+ * return its full size, -1 if a glyph is missing */
+static int tc_fill(const char *s, uint8_t len, uint8_t height){
+    const char *c=s;
+    const uint8_t *data;
+    int width, pre, post, size=len;
+    uint8_t *p;
+
+    if(tc_free+len<=sizeof(tc_pool))
+        memcpy(tc_pool+tc_free,s,len);
+    while(*c){
+        width=_getGlyph(_nextChar(&c),&data,&pre,&post);
+        if(width<0)
+            return -1;
+        if(tc_free+size+(pre+width+post)*height<=sizeof(tc_pool)){
+            p=tc_pool+tc_free+size;
+            memset(p,0,pre*height);
+            memcpy(p+pre*height,data,width*height);
+            memset(p+(pre+width)*height,0,post*height);
+        };
+        size+=(pre+width+post)*height;
+    };
+    return size;
+};
+
+static TCRUN *tc_make(const char *s, uint8_t len){
+    uint8_t height=(font->u8Height-1)/8+1;
+    int size;
+    TCRUN *r;
+
+    /* a run that can never fit must not throw out the others */
+    size=tc_fill(s,len,height);
+    if(size<0 || size>sizeof(tc_pool))
+        return NULL;
+    if(tc_free+size<=sizeof(tc_pool)){
+        tc_end=tc_free+size;
+        if(tc_runs==TC_RUNS)
+            tc_evict();
+    }else{
+        tc_end=tc_free;
+        while(tc_runs==TC_RUNS || tc_free+size>sizeof(tc_pool))
+            tc_evict();
+        tc_fill(s,len,height);
+        tc_end=tc_free+size;
+    };
+
+    r=&tc_run[tc_runs++];
+    r->font=font_key;
+    r->off=tc_free;
+    r->size=size;
+    r->width=(size-len)/height;
+    r->len=len;
+    r->used=++tc_clock;
+    tc_free=tc_end;
+    return r;
+};
+
+static TCRUN *tc_get(const char *s){
+    size_t len=strlen(s);
+    TCRUN *r;
+
+    if(len>255)
+        return NULL;
+    font_init();
+    if((r=tc_find(s,len)))
+        return r;
+    return tc_make(s,len);
+};
+#endif
+
 int DoString(int sx, int sy, const char *s){
 	const char *c;
-	int uc;
-	for(c=s;*c!=0;c++){
-#ifdef UTF8
-		/* will b0rk on non-utf8 */
-		if((*c&(128+64+32))==(128+64) && c[1]!=0){
-			uc=UT2(c); c+=1;
-			sx=DoChar(sx,sy,uc);
-		}else if( (*c&(128+64+32+16))==(128+64+32) && c[1]!=0 && c[2] !=0){
-			uc=UT3(c); c+=2;
-			sx=DoChar(sx,sy,uc);
-		}else
+#if CFG_TEXTCACHE
+    TCRUN *r;
+
+    if((r=tc_get(s))){
+        _drawColumns(sx,sy,tc_pool+r->off+r->len,r->width);
+        return sx+r->width;
+    };
 #endif
-		sx=DoChar(sx,sy,*c);
-	};
+	for(c=s;*c!=0;)
+		sx=DoChar(sx,sy,_nextChar(&c));
 	return sx;
 };
 
+/* Width DoString() would draw s with, without drawing it */
+int getStringWidth(const char *s){
+	const char *c;
+    const uint8_t *data;
+    int width=0, w, pre, post;
+#if CFG_TEXTCACHE
+    TCRUN *r;
+
+    if((r=tc_get(s)))
+        return r->width;
+#endif
+    font_init();
+	for(c=s;*c!=0;){
+        w=_getGlyph(_nextChar(&c),&data,&pre,&post);
+        if(w>=0)
+            width+=pre+w+post;
+    };
+	return width;
+};
+
 int DoInt(int sx, int sy, int num){
 #define mxlen 5
 	char s[(mxlen+1)];
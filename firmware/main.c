@@ -35,6 +35,8 @@
 void wrapper(void);
 
 int main(void) {
+    stackPaint();                             // for stackUsed()
+
     // Configure cpu and mandatory peripherals
     cpuInit();                                // Configure the CPU
 // we do it later
@@ -108,6 +108,14 @@ int CDC_WrOutBuf (const char *buffer, int *length)
   return (bytesWritten); 
 }
 
+/*----------------------------------------------------------------------------
+  number of bytes CDC_WrInBuf can take without blocking
+ *---------------------------------------------------------------------------*/
+int CDC_WrInBufFree (void)
+{
+  return CDC_BUF_SIZE - CDC_BUF_COUNT(CDC_InBuf) - 1;
+}
+
 /*----------------------------------------------------------------------------
   check if character(s) are available at CDC_OutBuf
  *---------------------------------------------------------------------------*/
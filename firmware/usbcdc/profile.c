@@ -0,0 +1,78 @@
+#include <sysinit.h>
+
+#include "basic/basic.h"
+#include "usbcdc/usb.h"
+#include "usbcdc/usbcore.h"
+#include "usbcdc/cdcuser.h"
+#include "usbcdc/profile.h"
+
+/* Samples are written straight into the CDC buffer from the interrupt,
+ * nothing else should write to CDC while profiling. Interrupts that
+ * run at the same priority are not sampled. */
+
+static uint32_t prof_dropped;
+
+static void prof_put(uint32_t w){
+    int len=sizeof(w);
+    CDC_WrInBuf((const char *)&w, &len);
+};
+
+void prof_sample(uint32_t *frame){
+    TMR_TMR16B0IR = TMR_TMR16B0IR_MR0;
+
+    if(!USB_Configuration)
+        return;
+    if(prof_dropped){
+        if(CDC_WrInBufFree()<12){
+            prof_dropped++;
+            return;
+        };
+        prof_put(PROF_DROP);
+        prof_put(prof_dropped);
+        prof_dropped=0;
+    }else if(CDC_WrInBufFree()<4){
+        prof_dropped++;
+        return;
+    };
+    prof_put(frame[6]);     /* stacked PC */
+};
+
+/* Hand the exception frame to prof_sample */
+void TIMER16_0_IRQHandler(void) __attribute__ ((naked));
+void TIMER16_0_IRQHandler(void){
+    __asm volatile(
+            "tst lr, #4\n"
+            "ite eq\n"
+            "mrseq r0, msp\n"
+            "mrsne r0, psp\n"
+            "b prof_sample\n"
+            );
+};
+
+void profStart(uint16_t hz){
+    uint32_t period=1000000/hz;
+
+    if(!USB_Configuration)
+        return;
+    if(period>0xffff)
+        period=0xffff;
+
+    prof_dropped=0;
+    prof_put(PROF_MAGIC);
+    prof_put(sizeof(uint32_t));
+    prof_put((uint32_t)&profStart);
+
+    SCB_SYSAHBCLKCTRL |= SCB_SYSAHBCLKCTRL_CT16B0;
+    TMR_TMR16B0TCR = TMR_TMR16B0TCR_COUNTERENABLE_DISABLED;
+    TMR_TMR16B0PR = CFG_CPU_CCLK/1000000 - 1;
+    TMR_TMR16B0TC = 0;
+    TMR_TMR16B0MR0 = period;
+    TMR_TMR16B0MCR = TMR_TMR16B0MCR_MR0_INT_ENABLED | TMR_TMR16B0MCR_MR0_RESET_ENABLED;
+    NVIC_EnableIRQ(TIMER_16_0_IRQn);
+    TMR_TMR16B0TCR = TMR_TMR16B0TCR_COUNTERENABLE_ENABLED;
+};
+
+void profStop(void){
+    TMR_TMR16B0TCR = TMR_TMR16B0TCR_COUNTERENABLE_DISABLED;
+    NVIC_DisableIRQ(TIMER_16_0_IRQn);
+};
@@ -0,0 +1,19 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <stdint.h>
+
+/* Sampling profiler. While running, CT16B0 interrupts hz times a second
+ * and the interrupted PC is streamed over USB CDC (see
+ * tools/profile/prof.pl). The stream starts with two 32-bit words,
+ * PROF_MAGIC and the width of the following words in bytes, then the
+ * address of profStart, so the host can relocate the samples, and the
+ * samples. PROF_DROP is followed by the number of samples lost because
+ * the CDC buffer was full. */
+#define PROF_MAGIC 0x31465250   /* "PRF1" */
+#define PROF_DROP  0xffffffff
+
+void profStart(uint16_t hz);
+void profStop(void);
+
+#endif
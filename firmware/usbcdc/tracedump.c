@@ -0,0 +1,32 @@
+#include <sysinit.h>
+
+#include "basic/basic.h"
+#include "basic/trace.h"
+#include "usbcdc/usb.h"
+#include "usbcdc/usbcore.h"
+#include "usbcdc/cdcuser.h"
+
+/* Send the trace ring over CDC, waiting for the host to take it */
+static void trace_put(const void *buf, int len){
+    while(CDC_WrInBufFree()<len)
+        if(!USB_Configuration)
+            return;
+    CDC_WrInBuf(buf, &len);
+};
+
+void traceDump(void){
+    TRACEEVENT ev;
+    uint32_t hdr[2];
+    uint16_t i;
+
+    if(!USB_Configuration)
+        return;
+    traceEnable(0);
+    hdr[0]=TRACE_MAGIC;
+    hdr[1]=traceCount();
+    trace_put(hdr, sizeof(hdr));
+    for(i=0;traceRead(i,&ev);i++)
+        trace_put(&ev, sizeof(ev));
+    traceClear();
+    traceEnable(1);
+};
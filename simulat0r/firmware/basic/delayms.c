@@ -1,2 +1,10 @@
-/* AUTOGENERATED SOURCE FILE */
+#define delayms _hideaway_delayms
 #include "../../../firmware/basic/delayms.c"
+#undef delayms
+
+void simDelayMs(uint32_t ms);
+
+void delayms(uint32_t ms)
+{
+  simDelayMs(ms);
+}
@@ -1,2 +1,12 @@
-/* AUTOGENERATED SOURCE FILE */
+#define randomInit _hideaway_randomInit
 #include "../../../firmware/basic/random.c"
+#undef randomInit
+
+#include "../../simcore/simulator.h"
+
+/* no ADC here: seed the pool from SIMULAT0R_SEED (see simcore.c) so runs
+   can be made reproducible */
+void randomInit(void)
+{
+    randomSeed(simRandomSeed());
+}
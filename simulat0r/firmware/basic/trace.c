@@ -0,0 +1,2 @@
+/* AUTOGENERATED SOURCE FILE */
+#include "../../../firmware/basic/trace.c"
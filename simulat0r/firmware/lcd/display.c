@@ -3,17 +3,52 @@
 #endif
 #define lcdDisplay _hideaway_lcdDisplay
 #define lcdInit _hideaway_lcdInit
+#define lcdDisplayPages _hideaway_lcdDisplayPages
+#define lcdDoubleBuffer _hideaway_lcdDoubleBuffer
+#define lcdFlip _hideaway_lcdFlip
+#define lcdFlipWait _hideaway_lcdFlipWait
+#define lcdGrayStart _hideaway_lcdGrayStart
+#define lcdGrayStop _hideaway_lcdGrayStop
+#define lcd_deadline _hideaway_lcd_deadline
 #include "../../../firmware/lcd/display.c"
 #undef lcdDisplay
 #undef lcdInit
+#undef lcdDisplayPages
+#undef lcdDoubleBuffer
+#undef lcdFlip
+#undef lcdFlipWait
+#undef lcdGrayStart
+#undef lcdGrayStop
+#undef lcd_deadline
 #ifdef __APPLE__
 #undef lcdRefresh
 #endif
 
+/* display.h was read with the names above hidden */
+void lcdDisplay(void);
+void lcdDoubleBuffer(uint8_t *front);
+void lcdFlip(void);
+void lcdFlipWait(void);
+void lcdGrayStart(uint8_t *planes, uint8_t bits, uint16_t hz);
+void lcdGrayStop(void);
+uint32_t lcd_deadline(uint32_t max);
+
 #include "simulator.h"
 
+static void simGrayPoll(void);
+
 void lcdDisplay() {
+  if(lcd_gray) {
+    simGrayPoll();
+    return;
+  }
+  TRACE_BEGIN(TR_LCD,0);
   simlcdDisplayUpdate();
+  TRACE_END(TR_LCD,0);
+}
+
+void lcdDisplayPages(uint16_t mask) {
+  lcdDisplay();
 }
 
 #ifdef __APPLE__
@@ -22,5 +57,76 @@ void lcdRefresh() {
 }
 #endif
 
+/* No bus to wait for, a flip is an ordinary update */
+void lcdDoubleBuffer(uint8_t *front) {
+}
+
+void lcdFlip(void) {
+  lcdDisplay();
+}
+
+void lcdFlipWait(void) {
+}
+
+/* The terminal cannot flicker gray: once per gray cycle (each plane
+ * shown its share of ticks at hz) on the simulator clock, but at most
+ * SIM_GRAY_FPS times a second, the planes are shown ordered-dithered
+ * through lcdBuffer, which is left as it was. The idle loop and
+ * lcdDisplay() look whether a frame is due, like CT32B1 would. */
+#define SIM_GRAY_FPS 25
+
+static uint64_t simGrayNext;
+static uint32_t simGrayPeriod;  /* us */
+
+static void simGrayShow(void) {
+  static const uint8_t bayer[4][4]={{0,8,2,10},{12,4,14,6},{3,11,1,9},{15,7,13,5}};
+  uint8_t saved[RESX*RESY_B];
+  uint8_t max=(1<<lcd_graybits)-1;
+  int x, y;
+
+  memcpy(saved,lcdBuffer,sizeof(saved));
+  for(y=0;y<RESY;y++)
+    for(x=0;x<RESX;x++)
+      lcdSetPixel(x,y,lcdGrayGetPixel(x,y)*16>bayer[y&3][x&3]*max);
+  simlcdDisplayUpdate();
+  memcpy(lcdBuffer,saved,sizeof(saved));
+}
+
+static void simGrayPoll(void) {
+  uint64_t now=getMicros();
+
+  if(now<simGrayNext)
+    return;
+  simGrayShow();
+  simGrayNext=now+simGrayPeriod;
+}
+
+void lcdGrayStart(uint8_t *planes, uint8_t bits, uint16_t hz) {
+  lcdGrayStop();
+  if(!planes || !bits || bits>4 || !hz)
+    return;
+  lcd_gray=planes;
+  lcd_graybits=bits;
+  simGrayPeriod=1000000UL*((1<<bits)-1)/hz;
+  if(simGrayPeriod<1000000/SIM_GRAY_FPS)
+    simGrayPeriod=1000000/SIM_GRAY_FPS;
+  simGrayNext=getMicros()+simGrayPeriod;
+}
+
+void lcdGrayStop(void) {
+  lcd_gray=NULL;
+}
+
+/* Ticks the idle loop may sleep until the next gray frame */
+uint32_t lcd_deadline(uint32_t max) {
+  uint32_t ticks;
+
+  if(!lcd_gray)
+    return max;
+  simGrayPoll();
+  ticks=(simGrayNext-getMicros())/(SYSTICKSPEED*1000);
+  return ticks<max?ticks:max;
+}
+
 void lcdInit() {
 }
@@ -0,0 +1,67 @@
+/* The simulat0r has no CT16B0 and no USB: sample the host PC on
+   SIGPROF instead and write the same stream to the file named by
+   SIMULAT0R_PROFILE (default simulat0r.prof). */
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <ucontext.h>
+#include <sys/time.h>
+
+#include "../../../firmware/usbcdc/profile.h"
+
+static int prof_fd=-1;
+
+static void prof_put(uintptr_t w) {
+  if(write(prof_fd,&w,sizeof(w))!=sizeof(w)) {
+    ;
+  }
+}
+
+static void prof_put32(uint32_t w) {
+  if(write(prof_fd,&w,sizeof(w))!=sizeof(w)) {
+    ;
+  }
+}
+
+static void prof_sample(int sig, siginfo_t *si, void *ctx) {
+  ucontext_t *uc=ctx;
+#if defined(__x86_64__)
+  prof_put(uc->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__i386__)
+  prof_put(uc->uc_mcontext.gregs[REG_EIP]);
+#elif defined(__aarch64__)
+  prof_put(uc->uc_mcontext.pc);
+#else
+  (void)uc;
+#endif
+}
+
+void profStart(uint16_t hz) {
+  const char *name=getenv("SIMULAT0R_PROFILE");
+  struct sigaction sa={0};
+  struct itimerval it={{0,0},{0,0}};
+
+  if(prof_fd<0) {
+    prof_fd=open(name?name:"simulat0r.prof",O_WRONLY|O_CREAT|O_TRUNC,0644);
+    if(prof_fd<0)
+      return;
+    prof_put32(PROF_MAGIC);
+    prof_put32(sizeof(void *));
+    prof_put((uintptr_t)&profStart);
+  }
+
+  sa.sa_sigaction=prof_sample;
+  sa.sa_flags=SA_SIGINFO|SA_RESTART;
+  sigaction(SIGPROF,&sa,NULL);
+  it.it_interval.tv_usec=1000000/hz;
+  it.it_value=it.it_interval;
+  setitimer(ITIMER_PROF,&it,NULL);
+}
+
+void profStop(void) {
+  struct itimerval it={{0,0},{0,0}};
+  setitimer(ITIMER_PROF,&it,NULL);
+}
@@ -0,0 +1,29 @@
+/* The simulat0r has no USB: write the dump to the file named by
+   SIMULAT0R_TRACE (default simulat0r.trace) instead. simcore dumps
+   when the simulator exits if SIMULAT0R_TRACE is set. */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../../firmware/basic/trace.h"
+
+void traceDump(void) {
+  const char *name=getenv("SIMULAT0R_TRACE");
+  TRACEEVENT ev;
+  uint32_t hdr[2];
+  uint16_t i;
+  FILE *f;
+
+  f=fopen(name?name:"simulat0r.trace","wb");
+  if(!f)
+    return;
+  traceEnable(0);
+  hdr[0]=TRACE_MAGIC;
+  hdr[1]=traceCount();
+  fwrite(hdr,sizeof(hdr),1,f);
+  for(i=0;traceRead(i,&ev);i++)
+    fwrite(&ev,sizeof(ev),1,f);
+  fclose(f);
+  traceClear();
+  traceEnable(1);
+}
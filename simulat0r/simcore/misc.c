@@ -4,6 +4,13 @@ void __disable_irq() {
 void __enable_irq() {
 }
 
+unsigned int __get_PRIMASK() {
+  return 0;
+}
+
+void __set_PRIMASK(unsigned int mask) {
+}
+
 
 void notimplemented() {
 }
@@ -7,6 +7,14 @@
 
 #include "pmu/pmu.h"
 
+#include "usbcdc/profile.h"
+
+#include "simulator.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
 void ReinvokeISP(void);
 
 /**************************************************************************/
@@ -26,6 +34,13 @@ int simulator_main(void) {
   lcdFill(0);
   lcdDisplay();
 
+  // sample the whole run, see usbcdc/profile.h
+  if(getenv("SIMULAT0R_PROFILE"))
+    profStart(1000);
+  // keep the last CFG_TRACE events, see basic/trace.h
+  if(getenv("SIMULAT0R_TRACE"))
+    atexit(traceDump);
+
   wrapper(); // see module/ subdirectory
 }
 
@@ -40,3 +55,10 @@ void simSetLED(int led,uint32_t bitVal) {
   simSetLEDHook(led);
 }
 
+
+uint32_t simRandomSeed(void) {
+  const char *seed=getenv("SIMULAT0R_SEED");
+  if(seed)
+    return strtoul(seed,NULL,0);
+  return time(NULL)^getpid();
+}
@@ -12,6 +12,8 @@ void simSetLED(int led,uint32_t bitVal);
 void simSetLEDHook(int led);
 
 
+uint32_t simRandomSeed(void);
+
 int simulator_main(void);
 
 #endif
@@ -1,11 +1,91 @@
-#include <sys/time.h>
+#include <time.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 volatile uint32_t _timectr; // to satisfy linker
 
-volatile uint32_t simTimeCounter() {
-  struct timeval tv;
-  gettimeofday(&tv,NULL);
-  return (tv.tv_sec*1000000+tv.tv_usec)/100;
+/* The simulator clock runs in real time, or with SIMULAT0R_CLOCK=virtual
+ * on a virtual clock: idle sleeps and delays return at once and advance
+ * it, and every read advances it by SIM_CPU_STEP us so busy loops still
+ * see time pass. Together with SIMULAT0R_SEED a run is reproducible.
+ * SIMULAT0R_RUNTIME=seconds ends the run after that much (simulated)
+ * time. */
+#define SIM_CPU_STEP 1
+
+static int simVirtual=-1;
+static uint64_t simVirtualNow;
+static uint64_t simRunTime;
+
+static void simClockInit(void) {
+  const char *clock=getenv("SIMULAT0R_CLOCK");
+  const char *runtime=getenv("SIMULAT0R_RUNTIME");
+  simVirtual=clock && !strcmp(clock,"virtual");
+  if(runtime)
+    simRunTime=strtoull(runtime,NULL,0)*1000000ULL;
+}
+
+static void simAdvance(uint64_t us) {
+  if(simVirtual<0) simClockInit();
+  if(simVirtual)
+    simVirtualNow+=us;
+  else
+    usleep(us);
+}
+
+/* Stands in for getMicros(): monotonic microseconds since start */
+uint64_t simMicroCounter() {
+  static uint64_t start;
+  struct timespec ts;
+  uint64_t now;
+  if(simVirtual<0) simClockInit();
+  if(simVirtual) {
+    now=simVirtualNow+=SIM_CPU_STEP;
+  } else {
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    now=ts.tv_sec*1000000ULL+ts.tv_nsec/1000;
+    if(!start) start=now-1;
+    now-=start;
+  }
+  if(simRunTime && now>=simRunTime) {
+    simRunTime=0;
+    exit(0);
+  }
+  return now;
+}
+
+/* Stands in for _timectr: ticks of SYSTICKSPEED (10ms) */
+uint32_t simTimeCounter() {
+  return simMicroCounter()/10000;
+}
+
+/* Stands in for the busy-waiting delayms() */
+void simDelayMs(uint32_t ms) {
+  simAdvance(ms*1000ULL);
+}
+
+/* Tickless idle accounting, reported when the simulator exits */
+static uint64_t simSleepTicks;
+static uint32_t simStartTicks;
+static int simReporting;
+
+static void simIdleReport(void) {
+  uint32_t total=simTimeCounter()-simStartTicks;
+  fprintf(stderr,"simulat0r: idle sleep %u.%02us of %u.%02us (%u%%)%s\n",
+          (unsigned)(simSleepTicks/100),(unsigned)(simSleepTicks%100),
+          total/100,total%100,
+          total?(unsigned)(simSleepTicks*100/total):0,
+          simVirtual>0?" virtual":"");
+}
+
+void simIdleSleep(uint32_t ticks) {
+  if(!simReporting) {
+    simReporting=1;
+    simStartTicks=simTimeCounter();
+    atexit(simIdleReport);
+  }
+  simAdvance(ticks*10000ULL);
+  simSleepTicks+=ticks;
 }
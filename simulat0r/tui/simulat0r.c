@@ -4,18 +4,27 @@
 #include "../firmware/lcd/display.h"
 
 #include <unistd.h>
+#include <string.h>
 
+/* Frames are built in one buffer and only written when they changed,
+   which keeps long runs on the virtual clock from being output bound */
 void simlcdDisplayUpdate() {
-  write(1,"\033[H",3);
-  const char* symbolOff=GLOBAL(lcdinvert)?"_":"@";
-  const char* symbolOn=GLOBAL(lcdinvert)?"#":".";
+  static char frame[RESY*(RESX+1)+3], last[sizeof(frame)];
+  char symbolOff=GLOBAL(lcdinvert)?'_':'@';
+  char symbolOn=GLOBAL(lcdinvert)?'#':'.';
+  char *p=frame;
 
+  memcpy(p,"\033[H",3); p+=3;
   for(int y=0; y<RESY; ++y) {
     for(int x=0; x<RESX; ++x) {
-      write(1,(lcdGetPixel((GLOBAL(lcdmirror) /* LCD_MIRRORX */ )?(RESX-x-1):x,(0 /* & LCD_MIRRORY */)?(RESY-y-1):y)?symbolOn:symbolOff),1);
+      *p++=lcdGetPixel((GLOBAL(lcdmirror) /* LCD_MIRRORX */ )?(RESX-x-1):x,(0 /* & LCD_MIRRORY */)?(RESY-y-1):y)?symbolOn:symbolOff;
     }
-      write(1,("\n"),1);
+    *p++='\n';
   }
+  if(!memcmp(frame,last,sizeof(frame)))
+    return;
+  memcpy(last,frame,sizeof(frame));
+  write(1,frame,sizeof(frame));
 }
 
 int simButtonPressed(int button) {
@@ -15,16 +15,28 @@ $|=1;
 ### Runtime Options
 ###
 
-my ($verbose);
+my ($verbose,$anim,$output);
+my $delay=0;
+my $keyint=32;
 
 GetOptions (
             "verbose"  => \$verbose, # flag
+            "anim"     => \$anim,    # flag
+            "delay=i"  => \$delay,
+            "key=i"    => \$keyint,
+            "output=s" => \$output,
 			"help"     => sub {
 			print <<HELP;
-Uasge: img2lcd.pl [-v]
+Uasge: img2lcd.pl [-v] image
+       img2lcd.pl --anim [--delay ms] [--key n] [-o out.lcd] frame[\@ms] ...
 
 Options:
 --verbose         Be verbose.
+--anim            Encode the frames (images or .lcd files with raw frames)
+                  as a delta coded animation for lcdShowAnim().
+--delay ms        Default frame duration, 0: what lcdShowAnim() is told.
+--key n           A keyframe every n frames (default: 32).
+--output file     Output file (default: first input with .lcd).
 HELP
 			exit(-1);}
 			);
@@ -34,45 +46,154 @@ HELP
 ### Code starts here.
 ###
 
-my $in=shift || "i42.gif";
+use constant RESX   => 96;
+use constant RESY_B => 9;
+use constant FRAME  => RESX*RESY_B;
+
+# An image as lcdBuffer contents
+sub convert {
+	my $in=shift;
 
-my $out=$in;
-$out=~s/\..*/.lcd/;
+	load GD;
+	my $image = GD::Image->new($in) || die "$in: cannot read\n";
 
-load GD;
-my $image = GD::Image->new($in);
+	my $w=$image->width;
+	my $h=$image->height;
 
+	if($verbose){
+		print STDERR "$in: ${w}x$h\n\n";
+	};
 
-my $w=$image->width;
-my $h=$image->height;
+	my @img;
+	for my $y (0..$h-1){
+		for my $x (0..$w-1){
+			my $px= $image->getPixel($x,$y);
+			$px=1 if $px>1;
+			$img[$x][($y+4)/8]|=$px<<(7-($y+4)%8);
+			if($verbose){
+				$px=~y/01/ */; print STDERR $px;
+			};
+		};
+		if ($verbose){
+			print STDERR "<\n";
+		};
+	};
 
-if($verbose){
-	print STDERR "$in: ${w}x$h\n\n";
+	my $data="";
+	my $hb=int(($h-1)/8);
+	for my $y (0..$hb){
+		for my $x (0..$w-1){
+			$data.=chr($img[$w-$x-1][$hb-$y]||0);
+		};
+	};
+	return $data;
 };
 
-my @img;
-for my $y (0..$h-1){
-	for my $x (0..$w-1){
-		my $px= $image->getPixel($x,$y);
-        $px=1 if $px>1;
-		$img[$x][($y+4)/8]|=$px<<(7-($y+4)%8);
-		if($verbose){
-			$px=~y/01/ */; print STDERR $px;
+# Run length coding as in firmware/lcd/image.c: c<0x80 is followed by
+# c+1 literal bytes, c>=0x80 by one byte repeated c-0x80+3 times.
+sub rle {
+	my $d=shift;
+	my ($out,$lit)=("","");
+	my $i=0;
+
+	while($i<length $d){
+		my $c=substr($d,$i,1);
+		my $r=1;
+		$r++ while($i+$r<length $d && $r<130 && substr($d,$i+$r,1) eq $c);
+		if($r>=3){
+			$out.=chr(length($lit)-1).$lit if length $lit;
+			$lit="";
+			$out.=chr(0x80+$r-3).$c;
+			$i+=$r;
+		}else{
+			$lit.=$c;
+			$i++;
+			if(length $lit==128){
+				$out.=chr(127).$lit;
+				$lit="";
+			};
 		};
 	};
-	if ($verbose){
-		print STDERR "<\n";
+	$out.=chr(length($lit)-1).$lit if length $lit;
+	return $out;
+};
+
+# One frame: the blocks of 8 bytes that differ, XORed and run length coded
+sub delta {
+	my ($prev,$cur,$key,$ms)=@_;
+	$prev="\0" x FRAME if $key;
+	my $x=$prev ^ $cur;
+	my ($map,$data)=("","");
+
+	vec($map,FRAME/8-1,1)=0;
+	for my $b (0..FRAME/8-1){
+		my $block=substr($x,$b*8,8);
+		next if $block eq "\0" x 8;
+		vec($map,$b,1)=1;
+		$data.=$block;
 	};
+	my $body=$map.rle($data);
+	return pack("vvC",length $body,$ms,$key?1:0).$body;
 };
 
-open(F,">",$out)||die "open: $!";
+if($anim){
+	my (@frames,@ms);
+	for my $arg (@ARGV){
+		my ($in,$ms)=($arg=~/^(.*?)(?:\@(\d+))?$/);
+		$ms=$delay unless defined $ms;
+		my $data;
+		if($in=~/\.lcd$/i){
+			open(F,"<",$in)||die "open $in: $!";
+			binmode F;
+			local $/;
+			$data=<F>;
+			close(F);
+		}else{
+			$data=convert($in);
+		};
+		die "$in: not ".FRAME." bytes per frame\n" if !length $data || length($data)%FRAME;
+		for (my $o=0;$o<length $data;$o+=FRAME){
+			my $f=substr($data,$o,FRAME);
+			if(@frames && $f eq $frames[-1] && $ms && $ms[-1]){
+				$ms[-1]+=$ms;	# a repeated frame just lasts longer
+				next;
+			};
+			push @frames,$f;
+			push @ms,$ms;
+		};
+	};
+	die "no frames\n" unless @frames;
 
-$|=1;
-my $hb=int(($h-1)/8);
-for my $y (0..$hb){
-	for my $x (0..$w-1){
-		printf F "%c",$img[$w-$x-1][$hb-$y];
+	my $out=$output;
+	unless(defined $out){
+		($out=$ARGV[0])=~s/\@\d+$//;
+		die "$out: give an --output file\n" if $out=~/\.lcd$/i;
+		$out=~s/\.[^.\/]*$/.lcd/;
 	};
+
+	my $file=pack("a4CCv","LCDA",1,$keyint>255?255:$keyint,scalar @frames);
+	for my $i (0..$#frames){
+		my $key=!$i || ($keyint && $i%$keyint==0);
+		$file.=delta($i?$frames[$i-1]:"",$frames[$i],$key,$ms[$i]);
+	};
+
+	open(F,">",$out)||die "open: $!";
+	binmode F;
+	print F $file;
+	close(F);
+	printf STDERR "%s: %d frames, %d bytes, raw %d (%.1fx)\n",$out,
+		scalar @frames,length $file,@frames*FRAME,@frames*FRAME/length $file;
+	exit(0);
 };
 
+my $in=shift || "i42.gif";
+
+my $out=$output;
+($out=$in)=~s/\..*/.lcd/ unless defined $out;
+
+my $data=convert($in);
+
+open(F,">",$out)||die "open: $!";
+binmode F;
+print F $data;
 close(F);
@@ -0,0 +1,66 @@
+#!/usr/bin/perl
+
+# img2sprite.pl - converts an image to a sprite for lcdBlit()
+#
+# The sprite is written as a C array in the layout of lcdBuffer (see
+# firmware/lcd/display.h). Pixels with a color index >0 are set.
+
+use strict;
+use warnings;
+use Getopt::Long;
+use Module::Load;
+
+my ($verbose,$name);
+
+GetOptions (
+            "verbose"  => \$verbose, # flag
+            "name=s"   => \$name,
+			"help"     => sub {
+			print <<HELP;
+Usage: img2sprite.pl [-v] [-n name] image >sprite.h
+
+Options:
+--verbose         Be verbose.
+--name            Name of the array, default: the file name.
+HELP
+			exit(-1);}
+			);
+
+my $in=shift || die "no image given\n";
+
+if(!defined $name){
+	($name=$in)=~s!.*/!!;
+	$name=~s/\..*//;
+	$name=~s/\W/_/g;
+};
+
+load GD;
+my $image = GD::Image->new($in) || die "$in: cannot read\n";
+
+my $w=$image->width;
+my $h=$image->height;
+die "$in: ${w}x$h is too big, max. 255x255\n" if $w>255 || $h>255;
+
+my @page;
+for my $y (0..$h-1){
+	for my $x (0..$w-1){
+		my $px= $image->getPixel($x,$y);
+        $px=1 if $px>1;
+		my $r=$h-1-$y;          # row from the bottom
+		$page[$r>>3][$w-1-$x]|=$px<<($r&7);
+		if($verbose){
+			$px=~y/01/ */; print STDERR $px;
+		};
+	};
+	if ($verbose){
+		print STDERR "<\n";
+	};
+};
+
+print "/* $in, ${w}x$h */\n";
+print "static const uint8_t ${name}[]={\n    $w, $h,";
+for my $p (0..int(($h+7)/8)-1){
+	print "\n   ";
+	printf " 0x%02x,",$page[$p][$_]||0 for 0..$w-1;
+};
+print "\n};\n";
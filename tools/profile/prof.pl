@@ -0,0 +1,100 @@
+#!/usr/bin/perl
+#
+# vim:set ts=4 sw=4:
+#
+# Flat profile from a profiler stream (see firmware/usbcdc/profile.h).
+#
+# usage: prof.pl [-n nm] [-a] dump firmware.elf [l0dable.elf]
+#
+#   dump         recorded stream, e.g. "cat /dev/ttyACM0 >dump" while
+#                profiling, or the simulat0r.prof of the simulat0r
+#   firmware.elf the firmware (or the simulat0r binary) that was run
+#   l0dable.elf  the l0dable that was loaded, if any. It is linked at
+#                0x10002000 - RAMCODE and is not relocated.
+#   -n nm        nm to use, default arm-none-eabi-nm for the badge and
+#                nm for the simulat0r
+#   -a           also list the hottest addresses of each function
+
+use strict;
+use Getopt::Std;
+
+my %opt;
+getopts("n:a",\%opt);
+
+my $dump=shift || die "usage: $0 [-n nm] [-a] dump firmware.elf [l0dable.elf]\n";
+my $fw=shift || die "firmware .elf missing\n";
+my @l0=@ARGV;
+
+open(D,"<",$dump) || die "open $dump: $!";
+binmode(D);
+my $data=do { local $/; <D> };
+close(D);
+
+my ($magic,$width)=unpack("VV",$data);
+die "$dump: not a profile\n" if $magic != 0x31465250;
+die "$dump: bad sample width $width\n" if $width!=4 && $width!=8;
+my $fmt=$width==4?"V*":"Q<*";
+my @w=unpack($fmt,substr($data,8,length($data)-8-(length($data)-8)%$width));
+my $base=shift @w;
+
+my $nm=$opt{n} || ($width==4?"arm-none-eabi-nm":"nm");
+
+my @syms;	# [addr, name], sorted
+sub readsyms{
+	my ($elf,$prefix)=@_;
+	my $start;
+	open(NM,"-|",$nm,"-n","--defined-only",$elf) || die "$nm $elf: $!";
+	while(<NM>){
+		next unless /^([0-9a-f]+) ([tTwW]) (\S+)/;
+		my ($addr,$name)=(hex($1)&~1,$3);
+		$start=$addr if $name eq "profStart";
+		push @syms,[$addr,$prefix.$name];
+	};
+	close(NM);
+	return $start;
+};
+
+my $start=readsyms($fw,"");
+die "$fw: no profStart, wrong binary?\n" if !defined $start;
+my $slide=$base-$start;
+$_->[0]+=$slide for @syms;
+readsyms($_,"$_:") for @l0;
+@syms=sort {$a->[0] <=> $b->[0]} @syms;
+
+sub lookup{
+	my $pc=shift;
+	my ($lo,$hi)=(0,$#syms);
+	return undef if $hi<0 || $pc<$syms[0][0];
+	while($lo<$hi){
+		my $mid=int(($lo+$hi+1)/2);
+		if($syms[$mid][0]<=$pc){ $lo=$mid }else{ $hi=$mid-1 };
+	};
+	return $syms[$lo];
+};
+
+my (%func,%addr);
+my ($total,$dropped)=(0,0);
+while(@w){
+	my $pc=shift @w;
+	if($pc==0xffffffff){
+		$dropped+=shift @w;
+		next;
+	};
+	$total++;
+	my $s=lookup($pc&~1);
+	my $name=$s?$s->[1]:sprintf("?0x%x",$pc);
+	$func{$name}++;
+	$addr{$name}{$pc-($s?$s->[0]:0)}++;
+};
+
+printf "%d samples, %d dropped\n\n",$total,$dropped;
+printf "%7s %6s %6s  %s\n","samples","%","cum%","function";
+my $cum=0;
+for my $f (sort {$func{$b} <=> $func{$a}} keys %func){
+	$cum+=$func{$f};
+	printf "%7d %6.2f %6.2f  %s\n",$func{$f},100*$func{$f}/$total,100*$cum/$total,$f;
+	next unless $opt{a};
+	my $h=$addr{$f};
+	my @top=(sort {$h->{$b} <=> $h->{$a}} keys %$h)[0..4];
+	printf "%22s+0x%x %d\n","",$_,$h->{$_} for grep {defined} @top;
+};
@@ -0,0 +1,100 @@
+#!/usr/bin/perl
+#
+# vim:set ts=4 sw=4:
+#
+# Static RAM per module from the linker map, and what is left for the
+# stack. Compare with "RamInfo" in the debug l0dable for the stack
+# high-water mark.
+#
+# usage: ramuse.pl [-s n] [firmware.map]
+#
+#   firmware.map written by the firmware link, default firmware/firmware.map
+#   -s n         also list the n biggest variables (default 10)
+
+use strict;
+use Getopt::Std;
+
+my %opt;
+getopts("s:",\%opt);
+my $nsym=defined $opt{s}?$opt{s}:10;
+
+my $map=shift || "firmware.map";
+open(M,"<",$map) || die "open $map: $!";
+
+my ($ramstart,$ramsize);
+my ($out,$sec,$ebss);
+my (%mod,%sym,%kind,%common);
+my $pad=0;
+
+while(<M>){
+	chomp;s/\r$//;
+	if(/^Common symbol/../^Discarded input sections/){
+		$common{$1}=hex($2) if /^(\w+)\s+0x([0-9a-f]+)/i;
+		$common{$1}=hex($2) if /^(\w+)$/ && <M>=~/^\s+0x([0-9a-f]+)/i;
+		next;
+	};
+	if(/^sram\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)/i){
+		($ramstart,$ramsize)=(hex($1),hex($2));
+		next;
+	};
+	if(/^(\.[\w.]+)/){              # output section
+		$out=$1;
+		next;
+	};
+	next unless $out eq ".data" || $out eq ".bss";
+	if(/^\s+0x([0-9a-f]+)\s+_ebss = \./i){
+		$ebss=hex($1);
+		next;
+	};
+	if(/^ \*fill\*\s+0x[0-9a-f]+\s+0x([0-9a-f]+)/i){
+		$pad+=hex($1);
+		next;
+	};
+	if(/^ (\S+)$/){                 # input section name, rest on next line
+		$sec=$1;
+		$_=<M>;chomp;s/\r$//;
+		$_=" $sec$_";
+	};
+	if(/^ (\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)/i){
+		my ($s,$addr,$size,$file)=($1,hex($2),hex($3),$4);
+		next unless $size;
+		$file=~s!^.*/!!;
+		$mod{$file}+=$size;
+		$kind{$file}{$out}+=$size;
+		if($s=~/^\.(?:data|bss)\.(.+)/){
+			$sym{$1}=[$size,$file];
+		}elsif($s eq "COMMON"){
+			# symbols follow, sized from the common symbol table
+			while(<M>){
+				last unless /^\s+0x[0-9a-f]+\s+(\w+)$/i;
+				$sym{$1}=[$common{$1},$file];
+			};
+			redo if defined $_;
+		};
+	};
+};
+close(M);
+
+die "$map: no .data/.bss found\n" unless %mod;
+
+my $total=0;
+$total+=$_ for values %mod;
+
+printf "%-24s %6s %6s %6s\n","module","data","bss","total";
+for my $m (sort { $mod{$b} <=> $mod{$a} } keys %mod){
+	printf "%-24s %6d %6d %6d\n",$m,$kind{$m}{".data"},$kind{$m}{".bss"},$mod{$m};
+};
+printf "%-24s %6s %6s %6d\n","(alignment)","","",$pad if $pad;
+printf "%-24s %6s %6s %6d\n","static RAM","","",$total+$pad;
+
+if(defined $ramstart && defined $ebss){
+	printf "%-24s %6s %6s %6d\n","left for the stack","","",$ramstart+$ramsize-$ebss;
+};
+
+if($nsym){
+	print "\n";
+	printf "%-24s %6s  %s\n","variable","size","module";
+	my @s=sort { $sym{$b}[0] <=> $sym{$a}[0] } keys %sym;
+	splice(@s,$nsym) if @s>$nsym;
+	printf "%-24s %6d  %s\n",$_,@{$sym{$_}} for @s;
+};
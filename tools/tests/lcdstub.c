@@ -0,0 +1,53 @@
+/* lcdBuffer for host builds of the drawing code, same layout as
+ * firmware/lcd/display.c: pages from the bottom, columns right to left */
+
+#include <display.h>
+
+#define LCD_PAGE(y) ((RESY-1-(y))>>3)
+#define LCD_BIT(y)  (1<<((RESY-1-(y))&7))
+#define LCD_COL(x)  (RESX-1-(x))
+
+uint8_t lcdBuffer[RESX*RESY_B];
+
+void lcdSetPixel(char x, char y, bool f){
+    if(x<0 || x>=RESX || y<0 || y>=RESY)
+        return;
+    if(f)
+        lcdBuffer[LCD_PAGE(y)*RESX+LCD_COL(x)]|=LCD_BIT(y);
+    else
+        lcdBuffer[LCD_PAGE(y)*RESX+LCD_COL(x)]&=~LCD_BIT(y);
+}
+
+bool lcdGetPixel(char x, char y){
+    return (lcdBuffer[LCD_PAGE(y)*RESX+LCD_COL(x)]&LCD_BIT(y))!=0;
+}
+
+void lcdHSpan(int x0, int x1, int y, uint8_t mode){
+    uint8_t *d, m;
+    int n;
+
+    if(y<0 || y>=RESY)
+        return;
+    if(x0<0)
+        x0=0;
+    if(x1>RESX)
+        x1=RESX;
+    if(x0>=x1)
+        return;
+
+    m=LCD_BIT(y);
+    d=lcdBuffer+LCD_PAGE(y)*RESX+LCD_COL(x1-1);
+    n=x1-x0;
+    switch(mode){
+        case BLIT_OR:
+            while(n--) *d++|=m;
+            break;
+        case BLIT_XOR:
+            while(n--) *d++^=m;
+            break;
+        case BLIT_CLEAR:
+            m=~m;
+            while(n--) *d++&=m;
+            break;
+    };
+}
@@ -0,0 +1,133 @@
+/* Compiled programs in o (o_compile()/o_draw() in firmware/lcd/o.c,
+ * built with O_ENABLE_COMPILE): the rocket from l0dable/rockets.c and a
+ * box has to come out of o_draw() the same as out of o_render() under
+ * many transforms, after the transform changed, and from a buffer too
+ * small to compile into. Then the time o_render(), o_draw() and
+ * o_compile() take for it, on and off the screen, the best of 7 runs in
+ * CPU time. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lcd/display.h"
+#include "lcd/o.h"
+
+#define TRANSFORMS 3000
+#define RUNS       7
+#define DRAWS      5000
+
+static signed char rakett[] = {
+    ' ', 'm',38,6,
+    'c',38,6,36,13,36,15,
+    'c',24,22,23,26,21,32,'c',19,41,23,61,23,61,'c',15,73,14,95,17,110,'l',26,109,'c',26,102,26,87,30,83,'c',30,83,30,88,30,95,'c',31,103,31,108,31,108,'l',36,108,'c',36,108,35,98,36,91,'c',37,83,38,80,38,80,'c',41,79,43,80,47,79,'c',56,85,56,89,58,99,'c',58,103,58,108,58,108,'l',68,108,'c',67,89,69,73,54,58,'c',54,58,56,41,53,31,'c',50,21,40,15,40,15,'l',38,6,'z','g',100,'f','g',100,'s',
+    ' ', 'm',33,20,'c',31,20,29,21,27,22,'c',25,24,23,27,22,29,'c',20,35,21,38,21,38,'c',26,38,29,36,34,33,'c',38,31,42,24,34,21,'c',34,21,33,20,33,20,'z','g',0,'f',
+    ' ', 'm',60,0,'l',90,0,'l',90,20,'l',60,20,'z','g',100,'f',
+    '.'
+};
+
+static char buf[2048];
+static long code[256];
+static uint8_t want[RESX*RESY_B];
+static int failed;
+
+static void check(const char *name, int ok){
+    printf("ocompile: %-8s %s\n", name, ok ? "ok" : "FAIL");
+    if(!ok)
+        failed++;
+}
+
+static double cpu(void){
+    struct timespec t;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    return t.tv_sec+t.tv_nsec*1e-9;
+}
+
+/* scaled, sheared and moved around, partly off the screen */
+static void transform(int n){
+    OMatrix m={{{500+n%300,n%50},{-(n%40),500+n%300},{(n%70)*10-100,(n%30)*10}}};
+
+    o_transform(&m,1);
+}
+
+static void render(int n){
+    transform(n);
+    memset(lcdBuffer,0,sizeof(lcdBuffer));
+    o_render(rakett);
+    memcpy(want,lcdBuffer,sizeof(want));
+}
+
+static int draw(int n){
+    transform(n);
+    memset(lcdBuffer,0,sizeof(lcdBuffer));
+    o_draw(code);
+    return !memcmp(want,lcdBuffer,sizeof(want));
+}
+
+static double best(void (*f)(void)){
+    double t, b=0;
+    int r, n;
+
+    for(r=0;r<RUNS;r++){
+        t=cpu();
+        for(n=0;n<DRAWS;n++)
+            f();
+        t=cpu()-t;
+        if(!r || t<b)
+            b=t;
+    }
+    return b/DRAWS*1e6;
+}
+
+static void t_render(void)  { o_render(rakett); }
+static void t_draw(void)    { o_draw(code); }
+static void t_compile(void) { o_compile(code,sizeof(code),rakett); }
+
+int main(void){
+    OMatrix away={{{1023,0},{0,1023},{3000*1023,0}}};
+    int n, bad=0, size, x0, y0, x1, y1, bx0, by0, bx1, by1;
+
+    o_init(buf,sizeof(buf));
+
+    for(n=0;n<TRANSFORMS;n++){
+        render(n);
+        transform(n);
+        if(!o_compile(code,sizeof(code),rakett) || !draw(n))
+            bad++;
+    }
+    check("draw", bad==0);
+
+    transform(5);
+    o_compile(code,sizeof(code),rakett);
+    render(77);
+    check("moved", draw(77));
+
+    transform(77);
+    size=o_compile(code,200,rakett);
+    check("small", size==0 && draw(77));
+
+    transform(77);
+    o_compile(code,sizeof(code),rakett);
+    o_bounds_compiled(code,&x0,&y0,&x1,&y1);
+    o_bounds(rakett,&bx0,&by0,&bx1,&by1);
+    check("bounds", x0==bx0 && y0==by0 && x1==bx1 && y1==by1);
+
+    o_transform(&away,1);
+    memset(want,0,sizeof(want));
+    memset(lcdBuffer,0,sizeof(lcdBuffer));
+    o_compile(code,sizeof(code),rakett);
+    o_draw(code);
+    check("culled", !memcmp(want,lcdBuffer,sizeof(want)));
+
+    transform(123);
+    size=o_compile(code,sizeof(code),rakett);
+    printf("ocompile: %d bytes, o_render %.2fus o_draw %.2fus o_compile %.2fus\n",
+            size,best(t_render),best(t_draw),best(t_compile));
+    o_transform(&away,1);
+    o_compile(code,sizeof(code),rakett);
+    printf("ocompile: off screen o_render %.2fus o_draw %.2fus\n",
+            best(t_render),best(t_draw));
+    return failed!=0;
+}
@@ -0,0 +1,180 @@
+/* Filling in o (o_fill() in firmware/lcd/o.c): random polygons with
+ * holes against an even-odd reference at the pixel centers, and the
+ * rocket from l0dable/rockets.c in the 512 byte buffer it gets there,
+ * where its edges do not all fit and it is filled in bands, against the
+ * same rocket filled in one go. Then the time o_fill() takes for a full
+ * screen rectangle, a circle from four curves and the rocket, the best
+ * of 7 runs in CPU time. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lcd/display.h"
+#include "lcd/o.h"
+
+#define POLYGONS 3000
+#define RUNS     7
+#define FILLS    5000
+
+static signed char rakett[] = {
+    'm',38,6,
+    'c',38,6,36,13,36,15,
+    'c',24,22,23,26,21,32,'c',19,41,23,61,23,61,'c',15,73,14,95,17,110,'l',26,109,'c',26,102,26,87,30,83,'c',30,83,30,88,30,95,'c',31,103,31,108,31,108,'l',36,108,'c',36,108,35,98,36,91,'c',37,83,38,80,38,80,'c',41,79,43,80,47,79,'c',56,85,56,89,58,99,'c',58,103,58,108,58,108,'l',68,108,'c',67,89,69,73,54,58,'c',54,58,56,41,53,31,'c',50,21,40,15,40,15,'l',38,6,'z',
+    'm',33,20,'c',31,20,29,21,27,22,'c',25,24,23,27,22,29,'c',20,35,21,38,21,38,'c',26,38,29,36,34,33,'c',38,31,42,24,34,21,'c',34,21,33,20,33,20,'z',
+    '.'
+};
+
+static char buf[2048];
+static uint8_t want[RESX*RESY_B];
+static int px[16], py[16], sub[16], np;
+static int failed;
+
+static void check(const char *name, int ok){
+    printf("ofill: %-8s %s\n", name, ok ? "ok" : "FAIL");
+    if(!ok)
+        failed++;
+}
+
+static double cpu(void){
+    struct timespec t;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    return t.tv_sec+t.tv_nsec*1e-9;
+}
+
+/* even-odd at the center of pixel x,y; a pixel center right on an edge
+ * may go either way, take what was drawn */
+static int inside(int x, int y){
+    double xc=x+0.5, yc=y+0.5, x0, y0, x1, y1, xx;
+    int i, j, s0=0, c=0;
+
+    for(i=0;i<np;i++){
+        j=(i+1<np && !sub[i+1]) ? i+1 : s0;
+        x0=px[i]; y0=py[i];
+        x1=px[j]; y1=py[j];
+        if((y0<=yc)!=(y1<=yc)){
+            xx=x0+(yc-y0)*(x1-x0)/(y1-y0);
+            if(xx-xc<1e-3 && xc-xx<1e-3)
+                return lcdGetPixel(x,y);
+            if(xx<=xc)
+                c++;
+        }
+        if(i+1<np && sub[i+1])
+            s0=i+1;
+    }
+    return c&1;
+}
+
+static void polygons(void){
+    int t, i, x, y, bad=0;
+
+    srand(1);
+    for(t=0;t<POLYGONS;t++){
+        memset(lcdBuffer,0,sizeof(lcdBuffer));
+        o_path_new();
+        np=rand()%12+3;
+        for(i=0;i<np;i++){
+            px[i]=rand()%130-17;
+            py[i]=rand()%100-16;
+            /* up to a few subpaths, each at least three points */
+            sub[i]=i==0 || (i<np-2 && rand()%12==0);
+            if(sub[i])
+                o_move_to(px[i],py[i]);
+            else
+                o_line_to(px[i],py[i]);
+        }
+        o_fill();
+        for(y=0;y<RESY;y++)
+            for(x=0;x<RESX;x++)
+                if(lcdGetPixel(x,y)!=inside(x,y))
+                    bad++;
+    }
+    check("polygons", bad==0);
+}
+
+static void rocket(void){
+    const signed char *g=rakett;
+
+    o_path_new();
+    for(;;){
+        switch(*g++){
+            case 'm': o_move_to(g[0],g[1]); g+=2; break;
+            case 'l': o_line_to(g[0],g[1]); g+=2; break;
+            case 'c': o_curve_to(g[0],g[1],g[2],g[3],g[4],g[5]); g+=6; break;
+            case 'z': o_close(); break;
+            default:  return;
+        }
+    }
+}
+
+static void bands(void){
+    OMatrix m={{{600,0},{0,600},{120,20}}};
+    char small[512];
+
+    o_transform(&m,1);
+    memset(lcdBuffer,0,sizeof(lcdBuffer));
+    rocket();
+    o_fill();
+    memcpy(want,lcdBuffer,sizeof(want));
+
+    o_init(small,sizeof(small));
+    o_transform(&m,1);
+    memset(lcdBuffer,0,sizeof(lcdBuffer));
+    rocket();
+    o_fill();
+    check("bands", !memcmp(want,lcdBuffer,sizeof(want)));
+    o_init(buf,sizeof(buf));
+}
+
+static void shape(int w){
+    o_path_new();
+    if(w==0){
+        o_move_to(0,0);
+        o_line_to(RESX,0);
+        o_line_to(RESX,RESY);
+        o_line_to(0,RESY);
+        o_close();
+    }else if(w==1){
+        o_move_to(48,4);
+        o_curve_to(66,4,80,18,80,34);
+        o_curve_to(80,50,66,64,48,64);
+        o_curve_to(30,64,16,50,16,34);
+        o_curve_to(16,18,30,4,48,4);
+    }else
+        rocket();
+}
+
+static void timing(void){
+    OMatrix m[3]={
+        {{{1023,0},{0,1023},{0,0}}},
+        {{{1023,0},{0,1023},{0,0}}},
+        {{{600,0},{0,600},{120,20}}},
+    };
+    double best[3], t0;
+    int r, w, n;
+
+    for(w=0;w<3;w++){
+        o_transform(&m[w],1);
+        shape(w);
+        for(r=0;r<RUNS;r++){
+            t0=cpu();
+            for(n=0;n<FILLS;n++)
+                o_fill();
+            t0=cpu()-t0;
+            if(!r || t0<best[w])
+                best[w]=t0;
+        }
+    }
+    printf("ofill: rect %.2fus circle %.2fus rocket %.2fus\n",
+            best[0]/FILLS*1e6,best[1]/FILLS*1e6,best[2]/FILLS*1e6);
+}
+
+int main(void){
+    o_init(buf,sizeof(buf));
+    polygons();
+    bands();
+    timing();
+    return failed!=0;
+}
@@ -0,0 +1,114 @@
+/* Work queue and timer wheel (firmware/basic/idle.c): priority order,
+ * QT_PLUS entries, a full pool and one-shot/periodic timers. The same
+ * checks as s_prio in applications/tester/queue.c, without the LCD. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "basic/basic.h"
+
+static char trace[32];
+static int pos;
+static int ticks;
+static int failed;
+
+static void q_ui(void)    { trace[pos++]='u'; }
+static void q_radio(void) { trace[pos++]='r'; }
+static void q_store(void) { trace[pos++]='s'; }
+static void q_bg(void)    { trace[pos++]='b'; }
+static void q_tick(void)  { ticks++; }
+
+static uint8_t q_plus(uint8_t state){
+    trace[pos++]='0'+state;
+    if(state==0)
+        push_queue_prio(&q_ui, QP_UI);
+    if(state==2)
+        return QS_END;
+    return state+1;
+}
+
+static void drain(void){
+    while(the_queue.depth)
+        work_queue_minimal();
+    trace[pos]=0;
+}
+
+static void check(const char *name, int ok){
+    printf("queue: %-8s %s", name, ok ? "ok" : "FAIL");
+    if(!ok){
+        printf(" (trace \"%s\")", trace);
+        failed++;
+    }
+    printf("\n");
+    pos=0;
+    trace[0]=0;
+}
+
+/* Run the queue until t is no longer armed or limit ticks passed */
+static void run(QTIMER *t, uint32_t limit){
+    uint32_t start=getTimer();
+
+    while(t->armed && getTimer()-start<limit)
+        work_queue();
+    drain();
+}
+
+int main(void){
+    QTIMER once={.prio=QP_RADIO, .u.callback=&q_radio};
+    QTIMER other={.prio=QP_UI, .u.callback=&q_ui};
+    QTIMER every={.prio=QP_BACKGROUND, .period=2, .u.callback=&q_tick};
+    uint32_t start, took;
+    int i, dropped;
+
+    push_queue_prio(&q_bg, QP_BACKGROUND);
+    push_queue_prio(&q_store, QP_STORAGE);
+    push_queue_prio(&q_radio, QP_RADIO);
+    push_queue_prio(&q_ui, QP_UI);
+    push_queue_prio(&q_store, QP_STORAGE);
+    drain();
+    check("order", !strcmp(trace, "urssb"));
+
+    push_queue_plus_prio(&q_plus, QP_BACKGROUND);
+    push_queue_prio(&q_store, QP_STORAGE);
+    drain();
+    check("plus", !strcmp(trace, "s0u12"));
+
+    for(i=0;i<MAXQENTRIES;i++)
+        push_queue_prio(&q_bg, QP_BACKGROUND);
+    dropped=the_queue.dropped;
+    i=push_queue_prio(&q_ui, QP_UI);
+    check("full", i==-1 && the_queue.dropped==dropped+1);
+    drain();
+    check("drain", strlen(trace)==MAXQENTRIES && !the_queue.depth);
+
+    start=getTimer();
+    timerStart(&once, 30);
+    run(&once, 100);
+    took=getTimer()-start;
+    check("once", !strcmp(trace, "r") && took>=3 && took<=4);
+
+    /* restarting moves the expiry, stopping disarms */
+    start=getTimer();
+    timerStart(&once, 20);
+    timerStart(&once, 50);
+    timerStart(&other, 10);
+    timerStop(&other);
+    run(&once, 100);
+    took=getTimer()-start;
+    check("restart", !strcmp(trace, "r") && took>=5 && took<=6 && !other.armed);
+
+    ticks=0;
+    start=getTimer();
+    timerStart(&every, 0);
+    while(ticks<5 && getTimer()-start<100)
+        work_queue();
+    timerStop(&every);
+    took=getTimer()-start;
+    start=getTimer();
+    while(getTimer()-start<10)
+        work_queue();
+    drain();
+    check("every", ticks==5 && took>=9 && took<=10 && !every.armed);
+
+    return failed!=0;
+}
@@ -0,0 +1,12 @@
+/* What simulat0r/tui/simulat0r.c provides to the firmware, for tests
+ * that bring their own main() */
+
+void simlcdDisplayUpdate() {
+}
+
+int simButtonPressed(int button) {
+  return 1;
+}
+
+void simSetLEDHook(int led) {
+}
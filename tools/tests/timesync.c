@@ -0,0 +1,146 @@
+/* Mesh time sync (timeSync() in firmware/basic/simpletime.c, fed the
+ * way mesh_timesync() in firmware/funk/mesh.c does): N badges with
+ * crystals up to 100ppm off boot at random times, one of them with the
+ * wall clock set, and send [T]ime packets every 0.25-0.75s that 30% of
+ * the others hear 0.3-10.3ms later. After a settling time all clocks
+ * have to agree closely and run at the same rate: checked once a
+ * minute, by the median and the worst of those samples.
+ *
+ * simpletime.c is included so every badge can have its own copy of
+ * its state, swapped in by sel(). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "basic/simpletime.c"
+
+#define N         20
+#define RUNTIME   (4*3600)      /* s */
+#define SETTLE    1800
+#define LATENCY   5000          /* as TS_LATENCY in mesh.c */
+
+#define SAMPLES   ((RUNTIME-SETTLE)/60+1)
+#define MEDSPREAD 2000          /* us between the clocks of any two */
+#define MAXSPREAD 10000
+#define MEDRATE   25.0          /* ppm between the corrected rates */
+#define MAXSTEPS  (2*N)         /* clocks are stepped only to join */
+
+static double skew[N], boot[N];
+static time_t timet[N];
+static typeof(ts) st[N];
+static double now;              /* true time, us */
+static int cur;
+
+uint64_t getMicros(void){
+    return (uint64_t)((now-boot[cur])*(1+skew[cur]));
+}
+
+static void sel(int i){
+    st[cur]=ts;
+    timet[cur]=_timet;
+    cur=i;
+    ts=st[i];
+    _timet=timet[i];
+}
+
+/* fixed generator, the run is the same everywhere */
+static uint32_t seed=1;
+
+static double rnd(void){
+    seed^=seed<<13;
+    seed^=seed>>17;
+    seed^=seed<<5;
+    return seed/4294967296.0;
+}
+
+static double rate(int i){
+    return ((1+skew[i])*(1+st[i].freq/16777216.0)-1)*1e6;
+}
+
+static int cmp(const void *a, const void *b){
+    double d=*(const double *)a-*(const double *)b;
+    return d<0 ? -1 : d>0;
+}
+
+static double median(double *v, int n){
+    qsort(v,n,sizeof(*v),cmp);
+    return v[n/2];
+}
+
+int main(int argc, char **argv){
+    static double spread[SAMPLES], ratespread[SAMPLES];
+    double next[N], mn, mx, w, save, worst;
+    int i, j, n=0, steps=0, failed=0;
+
+    if(argc>1)
+        seed=strtoul(argv[1],NULL,0);
+    for(i=0;i<N;i++){
+        skew[i]=(rnd()*200-100)*1e-6;
+        boot[i]=rnd()*60e6;
+        next[i]=boot[i]+rnd()*1e6;
+    }
+    timet[0]=1324700000;
+    ts=st[0];
+    _timet=timet[0];
+
+    for(now=0;now<RUNTIME*1e6;now+=1000){
+        for(i=0;i<N;i++){
+            if(now<boot[i] || now<next[i])
+                continue;
+            next[i]=now+250e3+rnd()*500e3;
+
+            /* mesh_stamp() */
+            sel(i);
+            int64_t wall=getMicrosWall();
+            uint32_t sec=wall/1000000;
+            uint16_t ms=wall%1000000/1000+1;
+            uint32_t r=getMicrosRate();
+
+            for(j=0;j<N;j++){
+                if(j==i || now<boot[j] || rnd()>0.3)
+                    continue;
+                save=now;
+                now+=rnd()*10000+300;
+                sel(j);
+                steps+=timeSync((int64_t)sec*1000000+(ms-1)*1000+500+LATENCY,
+                        r,i+1,getMicros());
+                now=save;
+            }
+        }
+        if(now<SETTLE*1e6 || fmod(now,60e6) || n==SAMPLES)
+            continue;
+        mn=1e18;
+        mx=-1e18;
+        for(i=0;i<N;i++){
+            sel(i);
+            w=getMicrosWall();
+            if(w<mn) mn=w;
+            if(w>mx) mx=w;
+        }
+        sel(0);
+        spread[n]=mx-mn;
+        mn=1e18;
+        mx=-1e18;
+        for(i=0;i<N;i++){
+            if(rate(i)<mn) mn=rate(i);
+            if(rate(i)>mx) mx=rate(i);
+        }
+        ratespread[n++]=mx-mn;
+    }
+
+    worst=0;
+    for(i=0;i<n;i++)
+        if(spread[i]>worst)
+            worst=spread[i];
+    printf("timesync: spread   median %5.0fus worst %5.0fus %s\n",
+            median(spread,n),worst,
+            median(spread,n)<=MEDSPREAD && worst<=MAXSPREAD ? "ok" : "FAIL");
+    printf("timesync: rates    median %5.1fppm        %s\n",
+            median(ratespread,n),median(ratespread,n)<=MEDRATE ? "ok" : "FAIL");
+    printf("timesync: steps    %d               %s\n",
+            steps,steps<=MAXSTEPS ? "ok" : "FAIL");
+    failed=median(spread,n)>MEDSPREAD || worst>MAXSPREAD
+        || median(ratespread,n)>MEDRATE || steps>MAXSTEPS;
+    return failed;
+}
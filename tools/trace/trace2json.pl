@@ -0,0 +1,94 @@
+#!/usr/bin/perl
+#
+# vim:set ts=4 sw=4:
+#
+# Chrome trace-event JSON from a trace dump (see firmware/basic/trace.h),
+# for chrome://tracing or ui.perfetto.dev.
+#
+# usage: trace2json.pl [-n nm] [-e firmware.elf] dump >trace.json
+#
+#   dump         "TraceDump" of the debug l0dable captured from
+#                /dev/ttyACM0, or the simulat0r.trace of the simulat0r
+#   -e elf       name the work queue jobs after the functions in elf.
+#                Only the lower 16 bits of the address are recorded,
+#                which is all of the badge flash.
+#   -n nm        nm to use, default arm-none-eabi-nm
+
+use strict;
+use Getopt::Std;
+
+my %opt;
+getopts("n:e:",\%opt);
+
+my $dump=shift || die "usage: $0 [-n nm] [-e firmware.elf] dump\n";
+
+my %names=(
+	1 => "work",
+	2 => "lcdDisplay",
+	3 => "sspSend",
+	4 => "nrf_snd_pkt",
+	5 => "nrf_rcv_pkt",
+	6 => "f_read",
+	7 => "f_write",
+	8 => "execute_file",
+);
+my %signed=(5 => 1, 8 => 1);
+
+my %func;	# lower 16 bits => name, undef if ambiguous
+if($opt{e}){
+	my $nm=$opt{n} || "arm-none-eabi-nm";
+	open(NM,"-|",$nm,"--defined-only",$opt{e}) || die "$nm $opt{e}: $!";
+	while(<NM>){
+		next unless /^([0-9a-f]+) [tTwW] (\S+)/;
+		my $a=hex($1)&0xfffe;
+		$func{$a}=exists $func{$a}?undef:$2;
+	};
+	close(NM);
+};
+
+open(D,"<",$dump) || die "open $dump: $!";
+binmode(D);
+my $data=do { local $/; <D> };
+close(D);
+
+my ($magic,$count)=unpack("VV",$data);
+die "$dump: not a trace\n" if $magic != 0x31435254;
+$count=int((length($data)-8)/8) if $count*8>length($data)-8;
+
+my @out;
+my %open;	# id => number of slices open
+my ($last,$hi)=(undef,0);
+for my $i (0..$count-1){
+	my ($time,$id,$arg)=unpack("VCxv",substr($data,8+8*$i,8));
+	$hi+=1<<32 if defined $last && $time<$last;	# 32-bit wrap
+	$last=$time;
+	my $ts=$hi+$time;
+
+	my $phase=$id & 0xc0;
+	$id&=0x3f;
+	$arg-=0x10000 if $signed{$id} && $arg>=0x8000;
+	my $name=$names{$id} || ($id>=32?"user".($id-32):"event$id");
+	my %args=(arg => $arg);
+	if($id==1){
+		my $f=$func{$arg & 0xfffe};
+		$name=$f if defined $f;
+		%args=(fn => sprintf("0x%04x",$arg));
+	};
+
+	my $ph;
+	if($phase==0x00){
+		$ph="B";
+		$open{$id}++;
+	}elsif($phase==0x40){
+		next unless $open{$id};		# began before the oldest event
+		$open{$id}--;
+		$ph="E";
+	}else{
+		$ph="i";
+	};
+	my $a=join(",",map {sprintf($args{$_}=~/^-?\d+$/?"\"%s\":%s":"\"%s\":\"%s\"",$_,$args{$_})} sort keys %args);
+	push @out,sprintf("{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%d,\"pid\":1,\"tid\":1%s,\"args\":{%s}}",
+			$name,$ph,$ts,$ph eq "i"?",\"s\":\"t\"":"",$a);
+};
+
+print "{\"traceEvents\":[\n",join(",\n",@out),"\n]}\n";